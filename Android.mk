@@ -36,6 +36,7 @@ LOCAL_SRC_FILES := \
     common/base/Hwcomposer.cpp \
     common/base/HwcModule.cpp \
     common/base/DisplayAnalyzer.cpp \
+    common/base/RefreshRateGovernor.cpp \
     common/buffers/BufferCache.cpp \
     common/buffers/GraphicBuffer.cpp \
     common/buffers/BufferManager.cpp \
@@ -48,7 +49,10 @@ LOCAL_SRC_FILES := \
     common/observers/SoftVsyncObserver.cpp \
     common/planes/DisplayPlane.cpp \
     common/planes/DisplayPlaneManager.cpp \
-    common/utils/Dump.cpp
+    common/planes/DummyPlaneManager.cpp \
+    common/utils/Dump.cpp \
+    common/utils/HwcMetrics.cpp \
+    common/utils/FrameTracer.cpp
 
 LOCAL_SRC_FILES += \
     ips/common/BlankControl.cpp \
@@ -56,10 +60,12 @@ LOCAL_SRC_FILES += \
     ips/common/DrmControl.cpp \
     ips/common/VsyncControl.cpp \
     ips/common/OverlayPlaneBase.cpp \
+    ips/common/VideoFlipPacer.cpp \
     ips/common/SpritePlaneBase.cpp \
     ips/common/PixelFormat.cpp \
     ips/common/GrallocBufferBase.cpp \
     ips/common/GrallocBufferMapperBase.cpp \
+    ips/common/GrallocHandleCache.cpp \
     ips/common/TTMBufferMapper.cpp \
     ips/common/DrmConfig.cpp \
     ips/common/Wsbm.cpp \
@@ -91,7 +97,8 @@ LOCAL_C_INCLUDES := \
     $(TARGET_OUT_HEADERS)/libdrm \
     $(TARGET_OUT_HEADERS)/libwsbm/wsbm \
     $(TARGET_OUT_HEADERS)/libttm \
-    frameworks/native/include/media/openmax
+    frameworks/native/include/media/openmax \
+    system/core/libsync
 
 ifeq ($(TARGET_SUPPORT_HDMI_PRIMARY),true)
    LOCAL_CFLAGS += -DINTEL_SUPPORT_HDMI_PRIMARY
@@ -102,4 +109,70 @@ LOCAL_COPY_HEADERS_TO:=pvr/hal
 
 include $(BUILD_SHARED_LIBRARY)
 
+# host side reader for frame traces saved by the hwc
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := hwctrace
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS := -Werror
+LOCAL_SRC_FILES := tools/hwctrace/hwctrace.cpp
+LOCAL_C_INCLUDES := $(LOCAL_PATH)
+
+include $(BUILD_HOST_EXECUTABLE)
+
+# replays frame traces through hwc prepare and commit, Drm, DisplayQuery,
+# gralloc and the display context are stubbed so the display is never
+# touched
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := hwcreplay
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS := -Werror
+
+LOCAL_SHARED_LIBRARIES := liblog libcutils libutils libhardware
+
+LOCAL_SRC_FILES := \
+    common/base/HwcLayer.cpp \
+    common/base/HwcLayerList.cpp \
+    common/base/Hwcomposer.cpp \
+    common/base/DisplayAnalyzer.cpp \
+    common/base/RefreshRateGovernor.cpp \
+    common/buffers/BufferCache.cpp \
+    common/buffers/GraphicBuffer.cpp \
+    common/buffers/BufferManager.cpp \
+    common/devices/DummyDevice.cpp \
+    common/observers/UeventObserver.cpp \
+    common/observers/SoftVsyncObserver.cpp \
+    common/planes/DisplayPlane.cpp \
+    common/planes/DisplayPlaneManager.cpp \
+    common/planes/DummyPlaneManager.cpp \
+    common/utils/Dump.cpp \
+    common/utils/HwcMetrics.cpp \
+    common/utils/FrameTracer.cpp \
+    ips/common/DrmConfig.cpp \
+    ips/anniedale/PlaneCapabilities.cpp
+
+LOCAL_SRC_FILES += \
+    tools/hwcreplay/ReplayBufferManager.cpp \
+    tools/hwcreplay/ReplayDevice.cpp \
+    tools/hwcreplay/ReplayDisplayQuery.cpp \
+    tools/hwcreplay/ReplayDrm.cpp \
+    tools/hwcreplay/ReplayHwcomposer.cpp \
+    tools/hwcreplay/hwcreplay.cpp
+
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH) \
+    $(LOCAL_PATH)/include \
+    $(LOCAL_PATH)/include/pvr/hal \
+    $(TARGET_OUT_HEADERS)/libdrm \
+    $(TARGET_OUT_HEADERS)/libwsbm/wsbm \
+    $(TARGET_OUT_HEADERS)/libttm \
+    frameworks/native/include/media/openmax
+
+ifeq ($(TARGET_SUPPORT_HDMI_PRIMARY),true)
+   LOCAL_CFLAGS += -DINTEL_SUPPORT_HDMI_PRIMARY
+endif
+
+include $(BUILD_EXECUTABLE)
+
 endif
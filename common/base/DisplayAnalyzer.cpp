@@ -26,7 +26,8 @@ DisplayAnalyzer::DisplayAnalyzer()
       mCachedNumDisplays(0),
       mCachedDisplays(0),
       mPendingEvents(),
-      mEventMutex()
+      mEventMutex(),
+      mRefreshRateGovernor()
 {
 }
 
@@ -39,6 +40,11 @@ bool DisplayAnalyzer::initialize()
     mCachedNumDisplays = 0;
     mCachedDisplays = 0;
     mPendingEvents.clear();
+
+    if (!mRefreshRateGovernor.initialize()) {
+        ELOGTRACE("failed to initialize refresh rate governor");
+        return false;
+    }
     mInitialized = true;
 
     return true;
@@ -47,6 +53,7 @@ bool DisplayAnalyzer::initialize()
 void DisplayAnalyzer::deinitialize()
 {
     mPendingEvents.clear();
+    mRefreshRateGovernor.deinitialize();
     mInitialized = false;
 }
 
@@ -58,6 +65,7 @@ void DisplayAnalyzer::analyzeContents(
     mCachedDisplays = displays;
 
     handlePendingEvents();
+    mRefreshRateGovernor.analyze(numDisplays, displays);
 }
 
 void DisplayAnalyzer::postHotplugEvent(bool connected)
@@ -70,6 +78,16 @@ void DisplayAnalyzer::postHotplugEvent(bool connected)
     Hwcomposer::getInstance().invalidate();
 }
 
+void DisplayAnalyzer::postVideoFrame(int disp, int64_t timestamp)
+{
+    mRefreshRateGovernor.onVideoFrame(disp, timestamp);
+}
+
+void DisplayAnalyzer::dump(Dump& d)
+{
+    mRefreshRateGovernor.dump(d);
+}
+
 void DisplayAnalyzer::postEvent(Event& e)
 {
     Mutex::Autolock lock(mEventMutex);
@@ -105,6 +123,9 @@ void DisplayAnalyzer::handlePendingEvents()
 
 void DisplayAnalyzer::handleHotplugEvent(bool connected)
 {
+    // new sink or no sink, forget the cadence and mode of the old one
+    mRefreshRateGovernor.reset();
+
     if (connected) {
         for (int i = 0; i < mCachedNumDisplays; i++) {
             setCompositionType(i, HWC_FRAMEBUFFER, true);
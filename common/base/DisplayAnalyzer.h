@@ -18,6 +18,8 @@
 
 #include <utils/threads.h>
 #include <utils/Vector.h>
+#include <common/utils/Dump.h>
+#include <common/base/RefreshRateGovernor.h>
 
 
 namespace android {
@@ -34,6 +36,8 @@ public:
     void deinitialize();
     void analyzeContents(size_t numDisplays, hwc_display_contents_1_t** displays);
     void postHotplugEvent(bool connected);
+    void postVideoFrame(int disp, int64_t timestamp);
+    void dump(Dump& d);
 
 private:
     enum DisplayEventType {
@@ -62,6 +66,7 @@ private:
     hwc_display_contents_1_t** mCachedDisplays;
     Vector<Event> mPendingEvents;
     Mutex mEventMutex;
+    RefreshRateGovernor mRefreshRateGovernor;
 };
 
 } // namespace intel
@@ -64,6 +64,7 @@ HwcLayer::HwcLayer(int index, hwc_layer_1_t *layer)
       mUsage(0),
       mHandle(0),
       mIsProtected(false),
+      mIsCompressed(false),
       mType(LAYER_FB),
       mPriority(0),
       mTransform(0),
@@ -213,6 +214,11 @@ bool HwcLayer::isProtected() const
     return mIsProtected;
 }
 
+bool HwcLayer::isCompressed() const
+{
+    return mIsCompressed;
+}
+
 hwc_layer_1_t* HwcLayer::getLayer() const
 {
     return mLayer;
@@ -334,6 +340,7 @@ void HwcLayer::setupAttributes()
         GraphicBuffer *gBuffer = (GraphicBuffer*)buffer;
         mUsage = gBuffer->getUsage();
         mIsProtected = GraphicBuffer::isProtectedBuffer((GraphicBuffer*)buffer);
+        mIsCompressed = GraphicBuffer::isCompressionBuffer((GraphicBuffer*)buffer);
         if (mIsProtected) {
             mPriority |= LAYER_PRIORITY_PROTECTED;
         } else if (PlaneCapabilities::isFormatSupported(DisplayPlane::PLANE_OVERLAY, this)) {
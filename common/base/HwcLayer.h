@@ -74,6 +74,7 @@ public:
     uint32_t getHandle() const;
     uint32_t getTransform() const;
     bool isProtected() const;
+    bool isCompressed() const;
     hwc_layer_1_t* getLayer() const;
     DisplayPlane* getPlane() const;
 
@@ -104,6 +105,7 @@ private:
     uint32_t mUsage;
     uint32_t mHandle;
     bool mIsProtected;
+    bool mIsCompressed;
     uint32_t mType;
     uint32_t mPriority;
     uint32_t mTransform;
@@ -14,6 +14,7 @@
 // limitations under the License.
 */
 #include <common/utils/HwcTrace.h>
+#include <common/utils/HwcMetrics.h>
 #include <common/base/Drm.h>
 #include <common/base/HwcLayerList.h>
 #include <Hwcomposer.h>
@@ -22,21 +23,110 @@
 #include <PlaneCapabilities.h>
 #include <DisplayQuery.h>
 #include <hal_public.h>
+#include <khronos/openmax/OMX_IntelVideoExt.h>
 
 namespace android {
 namespace intel {
 
-HwcLayerList::HwcLayerList(hwc_display_contents_1_t *list, int disp)
+// Plane assignment costs are in bytes fetched from memory per frame.
+// Composing a layer with GPU reads the layer and reads back and writes
+// the frame buffer target, weighted for shader power.
+static const uint64_t GPU_COMPOSITION_WEIGHT = 2;
+// fixed per frame power of an enabled plane, in the same unit
+static const uint64_t PLANE_POWER_COST[DisplayPlane::PLANE_MAX] = {
+    64 * 1024,      // PLANE_SPRITE
+    512 * 1024,     // PLANE_OVERLAY, scaler and color conversion
+    0,              // PLANE_PRIMARY, always on
+    0,              // PLANE_CURSOR
+};
+// protected content can't be composed by GPU
+static const uint64_t PROTECTED_COMPOSITION_COST = 1ULL << 40;
+static const uint64_t COST_INVALID = ~0ULL;
+// typical render compression ratio of UI content
+static const uint64_t COMPRESSION_RATIO = 2;
+
+static uint32_t getBitsPerPixel(uint32_t format)
+{
+    switch (format) {
+    case HAL_PIXEL_FORMAT_BGRA_8888:
+    case HAL_PIXEL_FORMAT_BGRX_8888:
+    case HAL_PIXEL_FORMAT_RGBA_8888:
+    case HAL_PIXEL_FORMAT_RGBX_8888:
+        return 32;
+    case HAL_PIXEL_FORMAT_RGB_565:
+    case HAL_PIXEL_FORMAT_YUY2:
+    case HAL_PIXEL_FORMAT_UYVY:
+        return 16;
+    case HAL_PIXEL_FORMAT_YV12:
+    case HAL_PIXEL_FORMAT_I420:
+    case HAL_PIXEL_FORMAT_NV12:
+    case OMX_INTEL_COLOR_FormatYUV420PackedSemiPlanar:
+    case OMX_INTEL_COLOR_FormatYUV420PackedSemiPlanar_Tiled:
+        return 12;
+    default:
+        return 32;
+    }
+}
+
+// bytes fetched to scan out or compose the source crop of a layer
+static uint64_t getFetchBytes(HwcLayer *hwcLayer)
+{
+    hwc_frect_t& src = hwcLayer->getLayer()->sourceCropf;
+    uint64_t w = (uint64_t)((int)src.right - (int)src.left);
+    uint64_t h = (uint64_t)((int)src.bottom - (int)src.top);
+    if ((int)w <= 0 || (int)h <= 0) {
+        w = hwcLayer->getBufferWidth();
+        h = hwcLayer->getBufferHeight();
+    }
+
+    uint64_t bytes = w * h * getBitsPerPixel(hwcLayer->getFormat()) / 8;
+    if (hwcLayer->isCompressed()) {
+        // compressed surfaces only go to planes that decode them
+        bytes /= COMPRESSION_RATIO;
+    }
+    return bytes;
+}
+
+// bytes of frame buffer target covered by a layer
+static uint64_t getTargetBytes(HwcLayer *hwcLayer)
+{
+    hwc_rect_t& dst = hwcLayer->getLayer()->displayFrame;
+    int w = dst.right - dst.left;
+    int h = dst.bottom - dst.top;
+    if (w <= 0 || h <= 0) {
+        return 0;
+    }
+    return (uint64_t)w * h * 4;
+}
+
+HwcLayerList::HwcLayerList(hwc_display_contents_1_t *list, int disp,
+                           DisplayPlaneManager *planeManager)
     : mList(list),
       mLayerCount(0),
       mLayers(),
       mFBLayers(),
       mSpriteCandidates(),
       mOverlayCandidates(),
+      mCursorCandidates(),
       mZOrderConfig(),
+      mFreeZOrderLayers((uint32_t)-1),
       mFrameBufferTarget(NULL),
-      mDisplayIndex(disp)
+      mFrameBufferTargetZOrder(-1),
+      mDisplayIndex(disp),
+      mPlaneManager(planeManager),
+      mForceFbScaling(false),
+      mFbScalingOverlay(false),
+      mCostSearch(false),
+      mSearchExhausted(false),
+      mEvaluations(0),
+      mSearchDeadline(0),
+      mChosenCost(COST_INVALID),
+      mRunnerUpCost(COST_INVALID),
+      mBestConfig()
 {
+    if (!mPlaneManager) {
+        mPlaneManager = Hwcomposer::getInstance().getPlaneManager();
+    }
     initialize();
 }
 
@@ -45,6 +135,60 @@ HwcLayerList::~HwcLayerList()
     deinitialize();
 }
 
+static inline uint64_t getLayerBit(HwcLayer *hwcLayer)
+{
+    uint32_t index = hwcLayer->getIndex();
+    return index < 64 ? (1ULL << index) : 0;
+}
+
+uint64_t HwcLayerList::CandidateArray::getBit(HwcLayer *layer)
+{
+    return getLayerBit(layer);
+}
+
+bool HwcLayerList::CandidateArray::add(HwcLayer *layer)
+{
+    uint64_t bit = getBit(layer);
+    if (!bit || (mMask & bit)) {
+        return false;
+    }
+
+    if (mCount >= MAX_CANDIDATE_LAYERS) {
+        WLOGTRACE("too many candidates, layer %d uses GLES", layer->getIndex());
+        return false;
+    }
+
+    // insertion sort, higher priority first
+    size_t i = mCount;
+    uint32_t priority = layer->getPriority();
+    while (i > 0 && mItems[i - 1]->getPriority() < priority) {
+        mItems[i] = mItems[i - 1];
+        i--;
+    }
+    mItems[i] = layer;
+    mCount++;
+    mMask |= bit;
+    return true;
+}
+
+void HwcLayerList::CandidateArray::removeAt(size_t index)
+{
+    if (index >= mCount) {
+        return;
+    }
+
+    mMask &= ~getBit(mItems[index]);
+    mCount--;
+    for (size_t i = index; i < mCount; i++) {
+        mItems[i] = mItems[i + 1];
+    }
+}
+
+bool HwcLayerList::CandidateArray::contains(HwcLayer *layer) const
+{
+    return (mMask & getBit(layer)) != 0;
+}
+
 bool HwcLayerList::checkSupported(int planeType, HwcLayer *hwcLayer)
 {
     bool valid = false;
@@ -108,6 +252,13 @@ bool HwcLayerList::checkSupported(int planeType, HwcLayer *hwcLayer)
         return false;
     }
 
+    // check buffer compression
+    valid = PlaneCapabilities::isCompressionSupported(planeType, hwcLayer);
+    if (!valid) {
+        VLOGTRACE("plane type %d: (compressed buffer)", planeType);
+        return false;
+    }
+
     // TODO: check visible region?
     return true;
 }
@@ -146,6 +297,10 @@ bool HwcLayerList::checkRgbOverlaySupported(HwcLayer *hwcLayer)
         return false;
     }
 
+    if (!PlaneCapabilities::isCompressionSupported(DisplayPlane::PLANE_OVERLAY, hwcLayer)) {
+        return false;
+    }
+
     uint32_t h = hwcLayer->getBufferHeight();
     const stride_t& stride = hwcLayer->getBufferStride();
     if (stride.rgb.stride > 4096) {
@@ -219,6 +374,10 @@ bool HwcLayerList::checkCursorSupported(HwcLayer *hwcLayer)
         return false;
     }
 
+    if (!PlaneCapabilities::isCompressionSupported(DisplayPlane::PLANE_CURSOR, hwcLayer)) {
+        return false;
+    }
+
     uint32_t trans = hwcLayer->getLayer()->transform;
     if (trans != 0) {
         WLOGTRACE("unexpected transform %u for cursor", trans);
@@ -245,9 +404,26 @@ bool HwcLayerList::checkCursorSupported(HwcLayer *hwcLayer)
     return true;
 }
 
+bool HwcLayerList::checkFbScalingOverlaySupported()
+{
+    if (!mFrameBufferTarget->getLayer()->handle) {
+        return false;
+    }
+
+    uint32_t width, height;
+    Drm *drm = Hwcomposer::getInstance().getDrm();
+    if (!drm->getDisplayResolution(mDisplayIndex, width, height)) {
+        return false;
+    }
+
+    return PlaneCapabilities::isFbScalingSupported(DisplayPlane::PLANE_OVERLAY,
+            mFrameBufferTarget, width, height);
+}
 
 bool HwcLayerList::initialize()
 {
+    PhaseTimer timer(HwcMetrics::PHASE_PLANE_ALLOCATION);
+
     if (!mList || mList->numHwLayers == 0) {
         ELOGTRACE("invalid hwc list");
         return false;
@@ -256,14 +432,11 @@ bool HwcLayerList::initialize()
     mLayerCount = (int)mList->numHwLayers;
     mLayers.setCapacity(mLayerCount);
     mFBLayers.setCapacity(mLayerCount);
-    mSpriteCandidates.setCapacity(mLayerCount);
-    mOverlayCandidates.setCapacity(mLayerCount);
-    mCursorCandidates.setCapacity(mLayerCount);
     mZOrderConfig.setCapacity(mLayerCount);
     Hwcomposer& hwc = Hwcomposer::getInstance();
 
-    PriorityVector rgbOverlayLayers;
-    rgbOverlayLayers.setCapacity(mLayerCount);
+    CandidateArray rgbOverlayLayers;
+    mForceFbScaling = DisplayQuery::forceFbScaling(mDisplayIndex);
 
     for (int i = 0; i < mLayerCount; i++) {
         hwc_layer_1_t *layer = &mList->hwLayers[i];
@@ -291,7 +464,7 @@ bool HwcLayerList::initialize()
             // by default use GPU composition
             hwcLayer->setType(HwcLayer::LAYER_FB);
             mFBLayers.add(hwcLayer);
-            if (!DisplayQuery::forceFbScaling(mDisplayIndex)) {
+            if (!mForceFbScaling) {
                 if (checkCursorSupported(hwcLayer)) {
                     mCursorCandidates.add(hwcLayer);
                 } else if (checkRgbOverlaySupported(hwcLayer)) {
@@ -328,6 +501,8 @@ bool HwcLayerList::initialize()
         return false;
     }
 
+    mFbScalingOverlay = mForceFbScaling && checkFbScalingOverlaySupported();
+
     // If has layer besides of FB_Target, but no FBLayers, skip plane allocation
     // Note: There is case that SF passes down a layerlist with only FB_Target
     // layer; we need to have this FB_Target to be flipped as well, otherwise it
@@ -346,27 +521,48 @@ bool HwcLayerList::initialize()
         } else {
             mOverlayCandidates.add(hwcLayer);
         }
-        rgbOverlayLayers.removeItemsAt(0);
+        rgbOverlayLayers.removeAt(0);
     }
 
+    buildOverlapIndex();
+
+    // buffers of plane candidates get mapped while planes are searched
+    mapAheadCandidates();
+
     allocatePlanes();
     //dump();
     return true;
 }
 
+void HwcLayerList::mapAheadCandidates()
+{
+    // buffers on private planes are never scanned out
+    Hwcomposer& hwc = Hwcomposer::getInstance();
+    BufferManager *bm = hwc.getBufferManager();
+    if (!bm || mPlaneManager != hwc.getPlaneManager()) {
+        return;
+    }
+
+    for (size_t i = 0; i < mOverlayCandidates.size(); i++) {
+        bm->mapAhead(mOverlayCandidates[i]->getHandle());
+    }
+    for (size_t i = 0; i < mSpriteCandidates.size(); i++) {
+        bm->mapAhead(mSpriteCandidates[i]->getHandle());
+    }
+}
+
 void HwcLayerList::deinitialize()
 {
     if (mLayerCount == 0) {
         return;
     }
 
-    DisplayPlaneManager *planeManager = Hwcomposer::getInstance().getPlaneManager();
     for (int i = 0; i < mLayerCount; i++) {
         HwcLayer *hwcLayer = mLayers.itemAt(i);
         if (hwcLayer) {
             DisplayPlane *plane = hwcLayer->detachPlane();
             if (plane) {
-                planeManager->reclaimPlane(mDisplayIndex, *plane);
+                mPlaneManager->reclaimPlane(mDisplayIndex, *plane);
             }
         }
         delete hwcLayer;
@@ -377,14 +573,50 @@ void HwcLayerList::deinitialize()
     mOverlayCandidates.clear();
     mSpriteCandidates.clear();
     mCursorCandidates.clear();
-    mZOrderConfig.clear();
+    while (mZOrderConfig.size()) {
+        freeZOrderLayer(mZOrderConfig.itemAt(0));
+        mZOrderConfig.removeAt(0);
+    }
     mFrameBufferTarget = NULL;
+    mFrameBufferTargetZOrder = -1;
+    mForceFbScaling = false;
+    mFbScalingOverlay = false;
     mLayerCount = 0;
 }
 
 
 bool HwcLayerList::allocatePlanes()
 {
+    // walk all valid assignments within the budget and keep the cheapest
+    mCostSearch = true;
+    mSearchExhausted = false;
+    mEvaluations = 0;
+    mSearchDeadline = systemTime(SYSTEM_TIME_MONOTONIC) + us2ns(COST_SEARCH_BUDGET_US);
+    mChosenCost = COST_INVALID;
+    mRunnerUpCost = COST_INVALID;
+    mBestConfig.clear();
+    mBestConfig.setCapacity(mLayerCount);
+
+    assignCursorPlanes();
+    mCostSearch = false;
+
+    if (mBestConfig.size()) {
+        for (size_t i = 0; i < mBestConfig.size(); i++) {
+            const PlannedLayer& planned = mBestConfig.itemAt(i);
+            addZOrderLayer(planned.planeType, planned.hwcLayer, planned.zorder);
+        }
+        if (attachPlanes()) {
+            return true;
+        }
+
+        WLOGTRACE("failed to attach lowest cost config, use first fit");
+        while (mZOrderConfig.size()) {
+            removeZOrderLayer(mZOrderConfig.itemAt(0));
+        }
+        mChosenCost = COST_INVALID;
+        mRunnerUpCost = COST_INVALID;
+    }
+
     return assignCursorPlanes();
 }
 
@@ -395,8 +627,7 @@ bool HwcLayerList::assignCursorPlanes()
         return assignOverlayPlanes();
     }
 
-    DisplayPlaneManager *planeManager = Hwcomposer::getInstance().getPlaneManager();
-    int planeNumber = planeManager->getFreePlanes(mDisplayIndex, DisplayPlane::PLANE_CURSOR);
+    int planeNumber = mPlaneManager->getFreePlanes(mDisplayIndex, DisplayPlane::PLANE_CURSOR);
     if (planeNumber == 0) {
         DLOGTRACE("no cursor plane available. candidates %d", cursorCandidates);
         return assignOverlayPlanes();
@@ -413,6 +644,9 @@ bool HwcLayerList::assignCursorPlanes()
         if (assignCursorPlanes(0, i)) {
             return true;
         }
+        if (isSearchStopped()) {
+            break;
+        }
         if (mZOrderConfig.size() != 0) {
             ELOGTRACE("ZOrder config is not cleaned up!");
         }
@@ -435,6 +669,9 @@ bool HwcLayerList::assignCursorPlanes(int index, int planeNumber)
             return true;
         }
         removeZOrderLayer(zlayer);
+        if (isSearchStopped()) {
+            break;
+        }
     }
     return false;
 }
@@ -446,8 +683,7 @@ bool HwcLayerList::assignOverlayPlanes()
         return assignSpritePlanes();
     }
 
-    DisplayPlaneManager *planeManager = Hwcomposer::getInstance().getPlaneManager();
-    int planeNumber = planeManager->getFreePlanes(mDisplayIndex, DisplayPlane::PLANE_OVERLAY);
+    int planeNumber = mPlaneManager->getFreePlanes(mDisplayIndex, DisplayPlane::PLANE_OVERLAY);
     if (planeNumber == 0) {
         DLOGTRACE("no overlay plane available. candidates %d", overlayCandidates);
         return assignSpritePlanes();
@@ -464,6 +700,9 @@ bool HwcLayerList::assignOverlayPlanes()
         if (assignOverlayPlanes(0, i)) {
             return true;
         }
+        if (isSearchStopped()) {
+            break;
+        }
         if (mZOrderConfig.size() != 0) {
             ELOGTRACE("ZOrder config is not cleaned up!");
         }
@@ -486,6 +725,9 @@ bool HwcLayerList::assignOverlayPlanes(int index, int planeNumber)
             return true;
         }
         removeZOrderLayer(zlayer);
+        if (isSearchStopped()) {
+            break;
+        }
     }
     return false;
 }
@@ -498,8 +740,7 @@ bool HwcLayerList::assignSpritePlanes()
     }
 
     //  number does not include primary plane
-    DisplayPlaneManager *planeManager = Hwcomposer::getInstance().getPlaneManager();
-    int planeNumber = planeManager->getFreePlanes(mDisplayIndex, DisplayPlane::PLANE_SPRITE);
+    int planeNumber = mPlaneManager->getFreePlanes(mDisplayIndex, DisplayPlane::PLANE_SPRITE);
     if (planeNumber == 0) {
         VLOGTRACE("no sprite plane available, candidates %d", spriteCandidates);
         return assignPrimaryPlane();
@@ -516,6 +757,9 @@ bool HwcLayerList::assignSpritePlanes()
         if (assignSpritePlanes(0, i)) {
             return true;
         }
+        if (isSearchStopped()) {
+            break;
+        }
 
         if (mOverlayCandidates.size() == 0 && mZOrderConfig.size() != 0) {
             ELOGTRACE("ZOrder config is not cleaned up!");
@@ -538,12 +782,19 @@ bool HwcLayerList::assignSpritePlanes(int index, int planeNumber)
             return true;
         }
         removeZOrderLayer(zlayer);
+        if (isSearchStopped()) {
+            break;
+        }
     }
     return false;
 }
 
 bool HwcLayerList::assignPrimaryPlane()
 {
+    if (isSearchStopped()) {
+        return false;
+    }
+
     // find a sprit layer that is not candidate but has lower priority than candidates.
     HwcLayer *spriteLayer = NULL;
     for (int i = (int)mSpriteCandidates.size() - 1; i >= 0; i--) {
@@ -566,7 +817,7 @@ bool HwcLayerList::assignPrimaryPlane()
     } else if (candidates == 0) {
         // none assigned, use primary plane for frame buffer target and set zorder to 0
         ok = assignPrimaryPlaneHelper(mFrameBufferTarget, 0);
-        if (!ok) {
+        if (!ok && !mCostSearch) {
             ELOGTRACE("failed to compose all layers to primary plane, should never happen");
         }
     } else if (candidates == layers) {
@@ -578,7 +829,7 @@ bool HwcLayerList::assignPrimaryPlane()
     } else {
         // check if the remaining planes can be composed to frame buffer target (FBT)
         // look up a legitimate Z order position to place FBT.
-        for (int i = 0; i < layers && !ok; i++) {
+        for (int i = 0; i < layers && !ok && !isSearchStopped(); i++) {
             if (mFBLayers[i]->mPlaneCandidate) {
                 continue;
             }
@@ -601,9 +852,25 @@ bool HwcLayerList::assignPrimaryPlane()
 bool HwcLayerList::assignPrimaryPlaneHelper(HwcLayer *hwcLayer, int zorder)
 {
     int type = DisplayPlane::PLANE_PRIMARY;
+    ZOrderLayer *zlayer;
+    bool ok;
 
-    ZOrderLayer *zlayer = addZOrderLayer(type, hwcLayer, zorder);
-    bool ok = attachPlanes();
+    if (hwcLayer == mFrameBufferTarget && mFbScalingOverlay) {
+        // a free overlay scales the frame buffer target to the display,
+        // otherwise the primary plane scales it with a GPU blit
+        zlayer = addZOrderLayer(DisplayPlane::PLANE_OVERLAY, hwcLayer, zorder);
+        ok = attachPlanes();
+        if (ok) {
+            return true;
+        }
+        removeZOrderLayer(zlayer);
+        if (isSearchStopped()) {
+            return false;
+        }
+    }
+
+    zlayer = addZOrderLayer(type, hwcLayer, zorder);
+    ok = attachPlanes();
     if (!ok) {
         removeZOrderLayer(zlayer);
     }
@@ -612,13 +879,17 @@ bool HwcLayerList::assignPrimaryPlaneHelper(HwcLayer *hwcLayer, int zorder)
 
 bool HwcLayerList::attachPlanes()
 {
-    DisplayPlaneManager *planeManager = Hwcomposer::getInstance().getPlaneManager();
-    if (!planeManager->isValidZOrder(mDisplayIndex, mZOrderConfig)) {
+    if (mCostSearch) {
+        // keep searching, the best config is attached afterwards
+        return evaluatePlanes();
+    }
+
+    if (!mPlaneManager->isValidZOrder(mDisplayIndex, mZOrderConfig)) {
         VLOGTRACE("invalid z order, size of config %d", mZOrderConfig.size());
         return false;
     }
 
-    if (!planeManager->assignPlanes(mDisplayIndex, mZOrderConfig)) {
+    if (!mPlaneManager->assignPlanes(mDisplayIndex, mZOrderConfig)) {
         WLOGTRACE("failed to assign planes");
         return false;
     }
@@ -640,6 +911,8 @@ bool HwcLayerList::attachPlanes()
             zlayer->hwcLayer->setType(HwcLayer::LAYER_OVERLAY);
             // update FB layers for smart composition
             mFBLayers.remove(zlayer->hwcLayer);
+        } else {
+            mFrameBufferTargetZOrder = zlayer->zorder;
         }
 
         zlayer->hwcLayer->attachPlane(zlayer->plane, mDisplayIndex);
@@ -651,13 +924,89 @@ bool HwcLayerList::attachPlanes()
             zlayer->plane->getIndex(),
             zlayer->zorder);
 
-        delete zlayer;
+        freeZOrderLayer(zlayer);
     }
 
     mZOrderConfig.clear();
     return true;
 }
 
+bool HwcLayerList::evaluatePlanes()
+{
+    if (mSearchExhausted) {
+        return false;
+    }
+
+    if (mEvaluations >= COST_SEARCH_MAX_EVALUATIONS ||
+        systemTime(SYSTEM_TIME_MONOTONIC) > mSearchDeadline) {
+        // stop with the best config found so far
+        if (mBestConfig.size()) {
+            VLOGTRACE("plane cost search stopped after %d configs", mEvaluations);
+            mSearchExhausted = true;
+            return false;
+        }
+    }
+
+    if (!mPlaneManager->isValidZOrder(mDisplayIndex, mZOrderConfig)) {
+        return false;
+    }
+
+    mEvaluations++;
+    uint64_t cost = getConfigCost();
+    if (cost >= mChosenCost) {
+        if (cost < mRunnerUpCost) {
+            mRunnerUpCost = cost;
+        }
+        return false;
+    }
+
+    mRunnerUpCost = mChosenCost;
+    mChosenCost = cost;
+    mBestConfig.clear();
+    for (size_t i = 0; i < mZOrderConfig.size(); i++) {
+        ZOrderLayer *zlayer = mZOrderConfig.itemAt(i);
+        PlannedLayer planned;
+        planned.planeType = zlayer->planeType;
+        planned.zorder = zlayer->zorder;
+        planned.hwcLayer = zlayer->hwcLayer;
+        mBestConfig.add(planned);
+    }
+    return false;
+}
+
+uint64_t HwcLayerList::getConfigCost()
+{
+    uint64_t cost = 0;
+
+    // layers scanned out by display planes, including frame buffer target
+    for (size_t i = 0; i < mZOrderConfig.size(); i++) {
+        ZOrderLayer *zlayer = mZOrderConfig.itemAt(i);
+        cost += getFetchBytes(zlayer->hwcLayer);
+        if (zlayer->planeType >= 0 && zlayer->planeType < DisplayPlane::PLANE_MAX) {
+            cost += PLANE_POWER_COST[zlayer->planeType];
+        }
+        if (mForceFbScaling && zlayer->hwcLayer == mFrameBufferTarget &&
+            zlayer->planeType != DisplayPlane::PLANE_OVERLAY) {
+            // scaling blit of the whole frame buffer target
+            cost += GPU_COMPOSITION_WEIGHT * 2 * getFetchBytes(zlayer->hwcLayer);
+        }
+    }
+
+    // layers left to GPU composition
+    for (size_t i = 0; i < mFBLayers.size(); i++) {
+        HwcLayer *hwcLayer = mFBLayers.itemAt(i);
+        if (hwcLayer->mPlaneCandidate) {
+            continue;
+        }
+        if (hwcLayer->isProtected()) {
+            cost += PROTECTED_COMPOSITION_COST;
+        }
+        cost += GPU_COMPOSITION_WEIGHT *
+            (getFetchBytes(hwcLayer) + 2 * getTargetBytes(hwcLayer));
+    }
+    return cost;
+}
+
 bool HwcLayerList::useAsFrameBufferTarget(HwcLayer *target)
 {
     // check if zorder of target can be used as zorder of frame buffer target
@@ -670,42 +1019,88 @@ bool HwcLayerList::useAsFrameBufferTarget(HwcLayer *target)
     // to be moved down to target layer in z order.
 
     int targetLayerIndex = target->getIndex();
+    uint64_t candidates;
 
-    // check candidate and noncandidate layers below this candidate does not overlap
-    for (int below = 0; below < targetLayerIndex; below++) {
+    // check candidate and noncandidate layers below this candidate does not overlap,
+    // walk down from the target collecting candidates above each noncandidate layer
+    candidates = 0;
+    for (int below = targetLayerIndex - 1; below >= 0; below--) {
         if (mFBLayers[below]->mPlaneCandidate) {
-            continue;
-        } else {
-            // check candidate layer above this noncandidate layer does not overlap
-            for (int above = below + 1; above < targetLayerIndex; above++) {
-                if (mFBLayers[above]->mPlaneCandidate == false) {
-                    continue;
-                }
-                if (hasIntersection(mFBLayers[above], mFBLayers[below])) {
-                    return false;
-                }
-            }
+            candidates |= getLayerBit(mFBLayers[below]);
+        } else if (getOverlaps(mFBLayers[below]) & candidates) {
+            return false;
         }
     }
 
-    // check candidate and noncandidate layers above this candidate does not overlap
+    // check candidate and noncandidate layers above this candidate does not overlap,
+    // walk up from the target collecting candidates below each noncandidate layer
+    candidates = 0;
     for (unsigned int above = targetLayerIndex + 1; above < mFBLayers.size(); above++) {
         if (mFBLayers[above]->mPlaneCandidate) {
+            candidates |= getLayerBit(mFBLayers[above]);
+        } else if (getOverlaps(mFBLayers[above]) & candidates) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void HwcLayerList::buildOverlapIndex()
+{
+    HwcLayer *sorted[MAX_INDEXED_LAYERS];
+    int active[MAX_INDEXED_LAYERS];
+    int count = 0;
+    int activeCount = 0;
+
+    memset(mOverlaps, 0, sizeof(mOverlaps));
+
+    // sort FB layers by left edge
+    for (size_t i = 0; i < mFBLayers.size(); i++) {
+        HwcLayer *hwcLayer = mFBLayers.itemAt(i);
+        if (!getLayerBit(hwcLayer)) {
             continue;
-        } else {
-            // check candidate layer below this noncandidate layer does not overlap
-            for (unsigned int below = targetLayerIndex + 1; below < above; below++) {
-                if (mFBLayers[below]->mPlaneCandidate == false) {
-                    continue;
-                }
-                if (hasIntersection(mFBLayers[above], mFBLayers[below])) {
-                    return false;
-                }
+        }
+        int left = hwcLayer->getLayer()->displayFrame.left;
+        int j = count++;
+        while (j > 0 && sorted[j - 1]->getLayer()->displayFrame.left > left) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = hwcLayer;
+    }
+
+    // sweep from left to right, a layer can only overlap the layers whose
+    // right edge is beyond its left edge
+    for (int i = 0; i < count; i++) {
+        int left = sorted[i]->getLayer()->displayFrame.left;
+        int kept = 0;
+        for (int j = 0; j < activeCount; j++) {
+            if (sorted[active[j]]->getLayer()->displayFrame.right > left) {
+                active[kept++] = active[j];
             }
         }
+        activeCount = kept;
+
+        for (int j = 0; j < activeCount; j++) {
+            HwcLayer *other = sorted[active[j]];
+            if (hasIntersection(sorted[i], other)) {
+                mOverlaps[sorted[i]->getIndex()] |= getLayerBit(other);
+                mOverlaps[other->getIndex()] |= getLayerBit(sorted[i]);
+            }
+        }
+        active[activeCount++] = i;
     }
+}
 
-    return true;
+uint64_t HwcLayerList::getOverlaps(HwcLayer *hwcLayer) const
+{
+    // layers out of the index are assumed to overlap everything,
+    // candidates always have an index bit as CandidateArray requires it
+    if (!getLayerBit(hwcLayer)) {
+        return (uint64_t)-1;
+    }
+    return mOverlaps[hwcLayer->getIndex()];
 }
 
 bool HwcLayerList::hasIntersection(HwcLayer *la, HwcLayer *lb)
@@ -726,7 +1121,7 @@ bool HwcLayerList::hasIntersection(HwcLayer *la, HwcLayer *lb)
 
 ZOrderLayer* HwcLayerList::addZOrderLayer(int type, HwcLayer *hwcLayer, int zorder)
 {
-    ZOrderLayer *layer = new ZOrderLayer;
+    ZOrderLayer *layer = allocZOrderLayer();
     layer->planeType = type;
     layer->hwcLayer = hwcLayer;
     layer->zorder = (zorder != -1) ? zorder : hwcLayer->getZOrder();
@@ -758,7 +1153,104 @@ void HwcLayerList::removeZOrderLayer(ZOrderLayer *layer)
         ELOGTRACE("plane is not candidate!, order %d", layer->zorder);
     }
     layer->hwcLayer->mPlaneCandidate = false;
-    delete layer;
+    freeZOrderLayer(layer);
+}
+
+ZOrderLayer* HwcLayerList::allocZOrderLayer()
+{
+    if (!mFreeZOrderLayers) {
+        // never expected, configs are limited by the plane count
+        WLOGTRACE("z order layer pool is exhausted");
+        return new ZOrderLayer;
+    }
+
+    int index = __builtin_ctz(mFreeZOrderLayers);
+    mFreeZOrderLayers &= ~(1U << index);
+    return &mZOrderLayerPool[index];
+}
+
+void HwcLayerList::freeZOrderLayer(ZOrderLayer *layer)
+{
+    if (layer < mZOrderLayerPool ||
+        layer >= mZOrderLayerPool + MAX_CANDIDATE_LAYERS) {
+        delete layer;
+        return;
+    }
+
+    mFreeZOrderLayers |= 1U << (layer - mZOrderLayerPool);
+}
+
+bool HwcLayerList::demoteLayer(HwcLayer *hwcLayer)
+{
+    DisplayPlane *plane = hwcLayer->getPlane();
+    if (!plane || hwcLayer == mFrameBufferTarget) {
+        return false;
+    }
+
+    // the layer is merged into the frame buffer target, which needs a plane
+    if (!mFrameBufferTarget->getPlane() || mFrameBufferTargetZOrder < 0) {
+        VLOGTRACE("frame buffer target is not on a plane");
+        return false;
+    }
+
+    // layers on planes between the demoted layer and the frame buffer
+    // target must not overlap it
+    int low = hwcLayer->getZOrder();
+    int high = mFrameBufferTargetZOrder;
+    if (low > high) {
+        int tmp = low;
+        low = high;
+        high = tmp;
+    }
+
+    uint64_t between = 0;
+    for (int i = 0; i < mLayerCount - 1; i++) {
+        HwcLayer *other = mLayers.itemAt(i);
+        if (other == hwcLayer || !other->getPlane()) {
+            continue;
+        }
+        if (other->getZOrder() > low && other->getZOrder() < high) {
+            between |= getLayerBit(other);
+        }
+    }
+    if (getOverlaps(hwcLayer) & between) {
+        VLOGTRACE("layer %d overlaps planes below frame buffer target", hwcLayer->getIndex());
+        return false;
+    }
+
+    // the remaining planes must still be a valid config
+    for (int i = 0; i < mLayerCount; i++) {
+        HwcLayer *other = mLayers.itemAt(i);
+        if (other == hwcLayer || !other->getPlane()) {
+            continue;
+        }
+        ZOrderLayer *zlayer = allocZOrderLayer();
+        zlayer->planeType = other->getPlane()->getType();
+        zlayer->zorder = (other == mFrameBufferTarget) ?
+            mFrameBufferTargetZOrder : other->getZOrder();
+        zlayer->plane = other->getPlane();
+        zlayer->hwcLayer = other;
+        mZOrderConfig.add(zlayer);
+    }
+
+    bool valid = mPlaneManager->isValidZOrder(mDisplayIndex, mZOrderConfig);
+    while (mZOrderConfig.size()) {
+        freeZOrderLayer(mZOrderConfig.itemAt(0));
+        mZOrderConfig.removeAt(0);
+    }
+    if (!valid) {
+        VLOGTRACE("invalid z order without layer %d", hwcLayer->getIndex());
+        return false;
+    }
+
+    // plane is disabled with the other reclaimed planes
+    hwcLayer->detachPlane();
+    mPlaneManager->reclaimPlane(mDisplayIndex, *plane);
+    hwcLayer->mPlaneCandidate = false;
+    hwcLayer->setType(HwcLayer::LAYER_FORCE_FB);
+    hwcLayer->getLayer()->hints &= ~HWC_HINT_CLEAR_FB;
+    mFBLayers.add(hwcLayer);
+    return true;
 }
 
 void HwcLayerList::setupSmartComposition()
@@ -820,6 +1312,11 @@ bool HwcLayerList::update(hwc_display_contents_1_t *list)
         }
 
         if (!hwcLayer->update(&list->hwLayers[i])) {
+            // other layers keep their planes if only this one moves to GLES
+            if (demoteLayer(hwcLayer)) {
+                ILOGTRACE("layer %d fallback to GLES", i);
+                continue;
+            }
             ok = false;
             hwcLayer->setCompositionType(HWC_FORCE_FRAMEBUFFER);
         }
@@ -989,6 +1486,18 @@ void HwcLayerList::dump(Dump& d)
                      i, type, planeType, planeIndex, zorder);
         }
     }
+
+    if (mChosenCost != COST_INVALID) {
+        d.append("  plane cost: chosen %lluKB, runner-up ",
+                 mChosenCost / 1024);
+        if (mRunnerUpCost != COST_INVALID) {
+            d.append("%lluKB", mRunnerUpCost / 1024);
+        } else {
+            d.append("none");
+        }
+        d.append(", %d configs evaluated%s\n",
+                 mEvaluations, mSearchExhausted ? " (budget exhausted)" : "");
+    }
 }
 
 
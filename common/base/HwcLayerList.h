@@ -19,6 +19,8 @@
 #include <common/utils/Dump.h>
 #include <hardware/hwcomposer.h>
 #include <utils/SortedVector.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
 #include <DataBuffer.h>
 #include <DisplayPlane.h>
 #include <DisplayPlaneManager.h>
@@ -30,7 +32,10 @@ namespace intel {
 
 class HwcLayerList {
 public:
-    HwcLayerList(hwc_display_contents_1_t *list, int disp);
+    // planes come from the given plane manager, the hwcomposer's one if
+    // none is given
+    HwcLayerList(hwc_display_contents_1_t *list, int disp,
+                 DisplayPlaneManager *planeManager = NULL);
     virtual ~HwcLayerList();
 
 public:
@@ -50,6 +55,7 @@ private:
     bool checkSupported(int planeType, HwcLayer *hwcLayer);
     bool checkRgbOverlaySupported(HwcLayer *hwcLayer);
     bool checkCursorSupported(HwcLayer *hwcLayer);
+    bool checkFbScalingOverlaySupported();
     bool allocatePlanes();
     bool assignCursorPlanes();
     bool assignCursorPlanes(int index, int planeNumber);
@@ -60,11 +66,21 @@ private:
     bool assignPrimaryPlane();
     bool assignPrimaryPlaneHelper(HwcLayer *hwcLayer, int zorder = -1);
     bool attachPlanes();
+    bool evaluatePlanes();
+    // true once the cost search ran out of its budget
+    bool isSearchStopped() const { return mCostSearch && mSearchExhausted; }
+    uint64_t getConfigCost();
     bool useAsFrameBufferTarget(HwcLayer *target);
     bool hasIntersection(HwcLayer *la, HwcLayer *lb);
+    void buildOverlapIndex();
+    void mapAheadCandidates();
+    uint64_t getOverlaps(HwcLayer *hwcLayer) const;
     ZOrderLayer* addZOrderLayer(int type, HwcLayer *hwcLayer, int zorder = -1);
     void removeZOrderLayer(ZOrderLayer *layer);
+    ZOrderLayer* allocZOrderLayer();
+    void freeZOrderLayer(ZOrderLayer *layer);
     void setupSmartComposition();
+    bool demoteLayer(HwcLayer *hwcLayer);
     void dump();
 
 private:
@@ -79,14 +95,35 @@ private:
         }
     };
 
-    class PriorityVector : public SortedVector<HwcLayer*> {
+    enum {
+        // bounded by the layers a display context can commit
+        MAX_CANDIDATE_LAYERS = 32,
+        // layers tracked by the overlap index, one bit per layer index
+        MAX_INDEXED_LAYERS = 64,
+    };
+
+    // candidate layers sorted by priority, highest first. Stored inline
+    // so the plane search neither allocates nor calls a virtual compare,
+    // layers beyond the capacity stay in GLES composition
+    class CandidateArray {
     public:
-        PriorityVector() {}
-        virtual int do_compare(const void* lhs, const void* rhs) const {
-            const HwcLayer* l = *(HwcLayer**)lhs;
-            const HwcLayer* r = *(HwcLayer**)rhs;
-            return r->getPriority() - l->getPriority();
-        }
+        CandidateArray() : mCount(0), mMask(0) {}
+        bool add(HwcLayer *layer);
+        void removeAt(size_t index);
+        bool contains(HwcLayer *layer) const;
+        HwcLayer* operator[](size_t index) const { return mItems[index]; }
+        HwcLayer* top() const { return mItems[0]; }
+        size_t size() const { return mCount; }
+        void clear() { mCount = 0; mMask = 0; }
+
+    private:
+        static uint64_t getBit(HwcLayer *layer);
+
+    private:
+        HwcLayer *mItems[MAX_CANDIDATE_LAYERS];
+        size_t mCount;
+        // membership by layer index
+        uint64_t mMask;
     };
 
     hwc_display_contents_1_t *mList;
@@ -94,12 +131,46 @@ private:
 
     HwcLayerVector mLayers;
     HwcLayerVector mFBLayers;
-    PriorityVector mSpriteCandidates;
-    PriorityVector mOverlayCandidates;
-    PriorityVector mCursorCandidates;
+    CandidateArray mSpriteCandidates;
+    CandidateArray mOverlayCandidates;
+    CandidateArray mCursorCandidates;
     ZOrderConfig mZOrderConfig;
+    // z order layers are taken from here during the plane search
+    ZOrderLayer mZOrderLayerPool[MAX_CANDIDATE_LAYERS];
+    uint32_t mFreeZOrderLayers;
+    // by layer index, mask of FB layers whose display frames overlap
+    uint64_t mOverlaps[MAX_INDEXED_LAYERS];
     HwcLayer *mFrameBufferTarget;
+    // z order the frame buffer target was attached with, -1 if not on a plane
+    int mFrameBufferTargetZOrder;
     int mDisplayIndex;
+    DisplayPlaneManager *mPlaneManager;
+    // frame buffer doesn't fit the display without scaling
+    bool mForceFbScaling;
+    // overlay can scale the frame buffer target instead of a GPU blit
+    bool mFbScalingOverlay;
+
+private:
+    enum {
+        // bounds of the lowest cost plane assignment search
+        COST_SEARCH_MAX_EVALUATIONS = 64,
+        COST_SEARCH_BUDGET_US = 300,
+    };
+
+    struct PlannedLayer {
+        int planeType;
+        int zorder;
+        HwcLayer *hwcLayer;
+    };
+
+    // when set, attachPlanes only scores the z order config
+    bool mCostSearch;
+    bool mSearchExhausted;
+    int mEvaluations;
+    nsecs_t mSearchDeadline;
+    uint64_t mChosenCost;
+    uint64_t mRunnerUpCost;
+    Vector<PlannedLayer> mBestConfig;
 };
 
 } // namespace intel
@@ -13,9 +13,11 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 */
+#include <unistd.h>
 #include <common/utils/HwcTrace.h>
 #include <Hwcomposer.h>
 #include <common/utils/Dump.h>
+#include <common/utils/HwcMetrics.h>
 #include <UeventObserver.h>
 
 namespace android {
@@ -31,12 +33,18 @@ Hwcomposer::Hwcomposer()
       mDisplayAnalyzer(0),
       mDisplayContext(0),
       mUeventObserver(0),
-      mInitialized(false)
+      mFrameTracer(0),
+      mInitialized(false),
+      mInitBegin(0),
+      mInitEnd(0),
+      mAsyncInitResult(false),
+      mInitTid(0)
 {
     CTRACE();
 
     mDisplayDevices.setCapacity(IDisplayDevice::DEVICE_COUNT);
     mDisplayDevices.clear();
+    mInitTimeline.setCapacity(INIT_STEP_COUNT);
 }
 
 Hwcomposer::~Hwcomposer()
@@ -63,8 +71,14 @@ bool Hwcomposer::prepare(size_t numDisplays,
         return false;
     }
 
+    PhaseTimer timer(HwcMetrics::PHASE_PREPARE);
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+
     mDisplayAnalyzer->analyzeContents(numDisplays, displays);
 
+    // buffers mapped ahead but not picked up by the last frames
+    mBufferManager->expireMapAhead();
+
     // disable reclaimed planes
     mPlaneManager->disableReclaimedPlanes();
 
@@ -97,6 +111,7 @@ bool Hwcomposer::prepare(size_t numDisplays,
         }
     }
 
+    mFrameTracer->recordPrepare(numDisplays, displays, start);
     return ret;
 }
 
@@ -113,6 +128,10 @@ bool Hwcomposer::commit(size_t numDisplays,
         return false;
     }
 
+    PhaseTimer timer(HwcMetrics::PHASE_COMMIT);
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    HwcMetrics::increase(HwcMetrics::COUNTER_FRAMES);
+
     mDisplayContext->commitBegin(numDisplays, displays);
 
     for (size_t i = 0; i < numDisplays; i++) {
@@ -138,6 +157,7 @@ bool Hwcomposer::commit(size_t numDisplays,
     }
 
     mDisplayContext->commitEnd(numDisplays, displays);
+    mFrameTracer->recordCommit(start);
     // return true always
     return true;
 }
@@ -335,14 +355,27 @@ void Hwcomposer::hotplug(__attribute__((unused))int disp, bool connected)
     RETURN_VOID_IF_NOT_INIT();
 
 #ifndef INTEL_SUPPORT_HDMI_PRIMARY
+    notifyHotplug(disp, connected);
+#endif
+
+    mDisplayAnalyzer->postHotplugEvent(connected);
+}
+
+void Hwcomposer::headlessHotplug(int disp, bool connected)
+{
+    RETURN_VOID_IF_NOT_INIT();
+
+    notifyHotplug(disp, connected);
+    mDisplayAnalyzer->postHotplugEvent(connected);
+}
+
+void Hwcomposer::notifyHotplug(int disp, bool connected)
+{
     if (mProcs && mProcs->hotplug) {
         DLOGTRACE("report hotplug on disp %d, connected %d", disp, connected);
         mProcs->hotplug(const_cast<hwc_procs_t*>(mProcs), disp, connected);
         DLOGTRACE("hotplug callback processed and returned!");
     }
-#endif
-
-    mDisplayAnalyzer->postHotplugEvent(connected);
 }
 
 void Hwcomposer::invalidate()
@@ -385,9 +418,53 @@ bool Hwcomposer::dump(char *buff, int buff_len, int * /* cur_len */)
     if (mBufferManager)
         mBufferManager->dump(d);
 
+    // dump display analyzer status
+    if (mDisplayAnalyzer)
+        mDisplayAnalyzer->dump(d);
+
+    // dump startup timeline
+    dumpInitTimeline(d);
+
+    // dump frame metrics
+    HwcMetrics::dump(d);
+
+    // save frame trace if enabled
+    mFrameTracer->dump(d);
+
     return true;
 }
 
+void Hwcomposer::addInitStep(const char *name, nsecs_t start)
+{
+    InitStep step;
+    step.name = name;
+    step.start = start;
+    step.end = systemTime(SYSTEM_TIME_MONOTONIC);
+    step.async = (gettid() != mInitTid);
+
+    Mutex::Autolock _l(mInitLock);
+    mInitTimeline.push_back(step);
+}
+
+void Hwcomposer::dumpInitTimeline(Dump& d)
+{
+    Mutex::Autolock _l(mInitLock);
+
+    d.append("-------------------------------------------------------------\n");
+    d.append("Startup timeline (total %lld us):\n",
+             (mInitEnd - mInitBegin) / 1000);
+    d.append("  STEP              | THREAD | START(us) | DURATION(us) \n");
+    d.append("--------------------+--------+-----------+--------------\n");
+    for (size_t i = 0; i < mInitTimeline.size(); i++) {
+        const InitStep& step = mInitTimeline.itemAt(i);
+        d.append("  %-17s | %6s | %9lld | %12lld \n",
+                 step.name,
+                 step.async ? "helper" : "main",
+                 (step.start - mInitBegin) / 1000,
+                 (step.end - step.start) / 1000);
+    }
+}
+
 void Hwcomposer::registerProcs(hwc_procs_t const *procs)
 {
     CTRACE();
@@ -395,43 +472,132 @@ void Hwcomposer::registerProcs(hwc_procs_t const *procs)
     if (!procs) {
         WLOGTRACE("procs is NULL");
     }
+
+    Mutex::Autolock _l(mProcsLock);
     mProcs = procs;
+    mProcsCond.broadcast();
 }
 
-bool Hwcomposer::initialize()
+bool Hwcomposer::waitForProcs(nsecs_t timeout)
 {
-    CTRACE();
-
-    // create drm
-    mDrm = new Drm();
-    if (!mDrm || !mDrm->initialize()) {
-        DEINIT_AND_RETURN_FALSE("failed to create DRM");
+    Mutex::Autolock _l(mProcsLock);
+    nsecs_t deadline = systemTime(SYSTEM_TIME_MONOTONIC) + timeout;
+    while (!mProcs) {
+        nsecs_t remaining = deadline - systemTime(SYSTEM_TIME_MONOTONIC);
+        if (remaining <= 0) {
+            return false;
+        }
+        mProcsCond.waitRelative(mProcsLock, remaining);
     }
+    return true;
+}
+
+bool Hwcomposer::threadLoop()
+{
+    // one shot, runs the steps that don't depend on Drm
+    mAsyncInitResult = initializeIndependentComponents();
+    return false;
+}
+
+bool Hwcomposer::initializeIndependentComponents()
+{
+    nsecs_t start;
 
     // create buffer manager
+    start = systemTime(SYSTEM_TIME_MONOTONIC);
     mBufferManager = createBufferManager();
     if (!mBufferManager || !mBufferManager->initialize()) {
-        DEINIT_AND_RETURN_FALSE("failed to create buffer manager");
+        ELOGTRACE("failed to create buffer manager");
+        return false;
+    }
+    addInitStep("BufferManager", start);
+
+    start = systemTime(SYSTEM_TIME_MONOTONIC);
+    mDisplayContext = createDisplayContext();
+    if (!mDisplayContext || !mDisplayContext->initialize()) {
+        ELOGTRACE("failed to create display context");
+        return false;
+    }
+    addInitStep("DisplayContext", start);
+
+    // open uevent socket, observer is started after devices are created
+    start = systemTime(SYSTEM_TIME_MONOTONIC);
+    mUeventObserver = new UeventObserver();
+    if (!mUeventObserver || !mUeventObserver->initialize()) {
+        ELOGTRACE("failed to initialize uevent observer");
+        return false;
+    }
+    addInitStep("UeventObserver", start);
+
+    return true;
+}
+
+bool Hwcomposer::initializeDrmComponents()
+{
+    nsecs_t start;
+
+    // create drm
+    start = systemTime(SYSTEM_TIME_MONOTONIC);
+    mDrm = new Drm();
+    if (!mDrm || !mDrm->initialize()) {
+        ELOGTRACE("failed to create DRM");
+        return false;
     }
+    addInitStep("Drm", start);
 
     // create display plane manager
+    start = systemTime(SYSTEM_TIME_MONOTONIC);
     mPlaneManager = createDisplayPlaneManager();
     if (!mPlaneManager || !mPlaneManager->initialize()) {
-        DEINIT_AND_RETURN_FALSE("failed to create display plane manager");
+        ELOGTRACE("failed to create display plane manager");
+        return false;
     }
+    addInitStep("PlaneManager", start);
 
-    mDisplayContext = createDisplayContext();
-    if (!mDisplayContext || !mDisplayContext->initialize()) {
-        DEINIT_AND_RETURN_FALSE("failed to create display context");
+    return true;
+}
+
+bool Hwcomposer::initialize()
+{
+    CTRACE();
+
+    nsecs_t start;
+    bool ret;
+
+    {
+        Mutex::Autolock _l(mInitLock);
+        mInitTimeline.clear();
+        mInitBegin = systemTime(SYSTEM_TIME_MONOTONIC);
+        mInitEnd = mInitBegin;
+        mInitTid = gettid();
     }
 
-    mUeventObserver = new UeventObserver();
-    if (!mUeventObserver || !mUeventObserver->initialize()) {
-        DEINIT_AND_RETURN_FALSE("failed to initialize uevent observer");
+    // gralloc, IMG display device and uevent socket don't depend on Drm,
+    // bring them up on a helper thread while Drm and planes are created
+    mAsyncInitResult = false;
+    mThread = new InitThread(this);
+    if (!mThread.get() ||
+        mThread->run("HwcInit", PRIORITY_URGENT_DISPLAY) != NO_ERROR) {
+        WLOGTRACE("failed to start init thread, initializing serially");
+        mThread = NULL;
+        mAsyncInitResult = initializeIndependentComponents();
+    }
+
+    ret = initializeDrmComponents();
+
+    // wait for the helper before touching anything it creates
+    if (mThread.get()) {
+        mThread->join();
+        mThread = NULL;
+    }
+
+    if (!ret || !mAsyncInitResult) {
+        DEINIT_AND_RETURN_FALSE("failed to initialize hwc components");
     }
 
     // create display device
     for (int i = 0; i < IDisplayDevice::DEVICE_COUNT; i++) {
+        start = systemTime(SYSTEM_TIME_MONOTONIC);
         IDisplayDevice *device = createDisplayDevice(i, *mPlaneManager);
         if (!device || !device->initialize()) {
             DEINIT_AND_DELETE_OBJ(device);
@@ -439,22 +605,37 @@ bool Hwcomposer::initialize()
         }
         // add this device
         mDisplayDevices.insertAt(device, i, 1);
+        addInitStep(device->getName(), start);
     }
 
+    start = systemTime(SYSTEM_TIME_MONOTONIC);
     mDisplayAnalyzer = new DisplayAnalyzer();
     if (!mDisplayAnalyzer || !mDisplayAnalyzer->initialize()) {
         DEINIT_AND_RETURN_FALSE("failed to initialize display analyzer");
     }
+    addInitStep("DisplayAnalyzer", start);
+
+    mFrameTracer = new FrameTracer();
+    if (!mFrameTracer || !mFrameTracer->initialize()) {
+        DEINIT_AND_RETURN_FALSE("failed to initialize frame tracer");
+    }
 
     // all initialized, starting uevent observer
     mUeventObserver->start();
 
+    {
+        Mutex::Autolock _l(mInitLock);
+        mInitEnd = systemTime(SYSTEM_TIME_MONOTONIC);
+    }
+    ILOGTRACE("hwc initialized in %lld us", (mInitEnd - mInitBegin) / 1000);
+
     mInitialized = true;
     return true;
 }
 
 void Hwcomposer::deinitialize()
 {
+    DEINIT_AND_DELETE_OBJ(mFrameTracer);
     DEINIT_AND_DELETE_OBJ(mDisplayAnalyzer);
 
     DEINIT_AND_DELETE_OBJ(mUeventObserver);
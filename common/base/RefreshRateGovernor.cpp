@@ -0,0 +1,371 @@
+/*
+// Copyright (c) 2014 Intel Corporation 
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include <cutils/properties.h>
+#include <stdlib.h>
+#include <string.h>
+#include <common/utils/HwcTrace.h>
+#include <common/base/RefreshRateGovernor.h>
+#include <Hwcomposer.h>
+#include <ExternalDevice.h>
+#include <khronos/openmax/OMX_IntelVideoExt.h>
+
+namespace android {
+namespace intel {
+
+// cadence must be stable and UI idle this long before switching
+static const nsecs_t ENTER_DELAY = seconds_to_nanoseconds(2);
+// video is considered stopped after no frame for this long
+static const nsecs_t VIDEO_TIMEOUT = milliseconds_to_nanoseconds(500);
+// UI updates further apart than this don't accumulate
+static const nsecs_t UI_EXIT_WINDOW = seconds_to_nanoseconds(1);
+// a mode set blanks the sink, don't switch more often than this
+static const nsecs_t MIN_SWITCH_INTERVAL = seconds_to_nanoseconds(3);
+
+static const int VIDEO_FRAME_RATES[] = { 24, 25, 30, 50, 60 };
+#define MAX_DISPLAY_CONFIGS     32
+
+RefreshRateGovernor::RefreshRateGovernor()
+    : mInitialized(false),
+      mEnabled(false),
+      mState(STATE_DEFAULT),
+      mLastTimestamp(0),
+      mIntervalCount(0),
+      mIntervalIndex(0),
+      mVideoFps(0),
+      mCadenceSince(0),
+      mLastVideoFrame(0),
+      mLastHandles(),
+      mLastUiUpdate(0),
+      mUiFrames(0),
+      mDefaultRate(0),
+      mVideoRate(0),
+      mLastSwitch(0),
+      mSwitches(0),
+      mReverts(0)
+{
+    memset(mIntervals, 0, sizeof(mIntervals));
+}
+
+RefreshRateGovernor::~RefreshRateGovernor()
+{
+    WARN_IF_NOT_DEINIT();
+}
+
+bool RefreshRateGovernor::initialize()
+{
+    char prop[PROPERTY_VALUE_MAX];
+    mEnabled = true;
+    if (property_get("debug.hwc.refresh_governor.enable", prop, "1") > 0) {
+        mEnabled = atoi(prop) ? true : false;
+    }
+    ILOGTRACE("refresh rate governor is %s", mEnabled ? "enabled" : "disabled");
+
+    reset();
+    mInitialized = true;
+    return true;
+}
+
+void RefreshRateGovernor::deinitialize()
+{
+    Mutex::Autolock _l(mLock);
+    mLastHandles.clear();
+    mInitialized = false;
+}
+
+void RefreshRateGovernor::reset()
+{
+    Mutex::Autolock _l(mLock);
+
+    // sink changed, the switched mode is gone with it
+    mState = STATE_DEFAULT;
+    mLastTimestamp = 0;
+    mIntervalCount = 0;
+    mIntervalIndex = 0;
+    mVideoFps = 0;
+    mCadenceSince = 0;
+    mLastVideoFrame = 0;
+    mLastHandles.clear();
+    mLastUiUpdate = 0;
+    mUiFrames = 0;
+    mDefaultRate = 0;
+    mVideoRate = 0;
+}
+
+void RefreshRateGovernor::onVideoFrame(int disp, int64_t timestamp)
+{
+    if (!mEnabled || disp != IDisplayDevice::DEVICE_EXTERNAL) {
+        return;
+    }
+
+    Mutex::Autolock _l(mLock);
+
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    int64_t interval = timestamp - mLastTimestamp;
+    mLastTimestamp = timestamp;
+    mLastVideoFrame = now;
+
+    // seek, pause or repeated frame, start over
+    if (interval <= 0 || interval > 200000) {
+        mIntervalCount = 0;
+        mIntervalIndex = 0;
+        return;
+    }
+
+    mIntervals[mIntervalIndex] = interval;
+    mIntervalIndex = (mIntervalIndex + 1) % CADENCE_SAMPLE_COUNT;
+    if (mIntervalCount < CADENCE_SAMPLE_COUNT) {
+        mIntervalCount++;
+    }
+
+    int fps = detectFrameRate();
+    if (fps != mVideoFps) {
+        if (fps) {
+            VLOGTRACE("video cadence %d fps", fps);
+        }
+        mVideoFps = fps;
+        mCadenceSince = now;
+    }
+}
+
+int RefreshRateGovernor::detectFrameRate()
+{
+    if (mIntervalCount < CADENCE_SAMPLE_COUNT) {
+        return 0;
+    }
+
+    int64_t sum = 0;
+    for (int i = 0; i < CADENCE_SAMPLE_COUNT; i++) {
+        sum += mIntervals[i];
+    }
+    int64_t mean = sum / CADENCE_SAMPLE_COUNT;
+
+    // reject variable frame rate content
+    for (int i = 0; i < CADENCE_SAMPLE_COUNT; i++) {
+        int64_t delta = mIntervals[i] - mean;
+        if (delta < 0) {
+            delta = -delta;
+        }
+        if (delta * 1000 > mean * CADENCE_JITTER) {
+            return 0;
+        }
+    }
+
+    for (size_t i = 0; i < sizeof(VIDEO_FRAME_RATES) / sizeof(VIDEO_FRAME_RATES[0]); i++) {
+        int64_t nominal = 1000000 / VIDEO_FRAME_RATES[i];
+        int64_t delta = mean - nominal;
+        if (delta < 0) {
+            delta = -delta;
+        }
+        if (delta * 1000 <= nominal * CADENCE_TOLERANCE) {
+            return VIDEO_FRAME_RATES[i];
+        }
+    }
+    return 0;
+}
+
+bool RefreshRateGovernor::isVideoLayer(hwc_layer_1_t& layer)
+{
+    BufferManager *bm = Hwcomposer::getInstance().getBufferManager();
+    DataBuffer *buffer = bm->lockDataBuffer((uint32_t)layer.handle);
+    if (!buffer) {
+        return false;
+    }
+
+    uint32_t format = buffer->getFormat();
+    bm->unlockDataBuffer(buffer);
+
+    return format == OMX_INTEL_COLOR_FormatYUV420PackedSemiPlanar ||
+           format == OMX_INTEL_COLOR_FormatYUV420PackedSemiPlanar_Tiled;
+}
+
+bool RefreshRateGovernor::isUiUpdated(hwc_display_contents_1_t *display)
+{
+    bool updated = (display->flags & HWC_GEOMETRY_CHANGED) ? true : false;
+    size_t count = display->numHwLayers - 1;
+
+    if (mLastHandles.size() != count) {
+        mLastHandles.clear();
+        mLastHandles.insertAt((buffer_handle_t)0, 0, count);
+        updated = true;
+    }
+
+    // any new buffer other than video is UI activity
+    for (size_t i = 0; i < count; i++) {
+        hwc_layer_1_t& layer = display->hwLayers[i];
+        if (layer.handle == mLastHandles.itemAt(i)) {
+            continue;
+        }
+        mLastHandles.editItemAt(i) = layer.handle;
+        if (!updated && layer.handle && !isVideoLayer(layer)) {
+            updated = true;
+        }
+    }
+    return updated;
+}
+
+int RefreshRateGovernor::getDefaultRefreshRate(IDisplayDevice *device)
+{
+    const uint32_t attributes[] = {
+        HWC_DISPLAY_VSYNC_PERIOD,
+        HWC_DISPLAY_NO_ATTRIBUTE,
+    };
+    int32_t period = 0;
+
+    if (!device->getDisplayAttributes(device->getActiveConfig(), attributes, &period) ||
+        period <= 0) {
+        return 0;
+    }
+    return (int)((1000000000LL + period / 2) / period);
+}
+
+int RefreshRateGovernor::findRefreshRate(IDisplayDevice *device, int fps)
+{
+    uint32_t configs[MAX_DISPLAY_CONFIGS];
+    size_t numConfigs = MAX_DISPLAY_CONFIGS;
+    const uint32_t attributes[] = {
+        HWC_DISPLAY_VSYNC_PERIOD,
+        HWC_DISPLAY_NO_ATTRIBUTE,
+    };
+
+    if (!device->getDisplayConfigs(configs, &numConfigs)) {
+        return 0;
+    }
+
+    // the lowest multiple of the cadence, all configs share the resolution
+    int best = 0;
+    for (size_t i = 0; i < numConfigs; i++) {
+        int32_t period = 0;
+        if (!device->getDisplayAttributes(configs[i], attributes, &period) ||
+            period <= 0) {
+            continue;
+        }
+        int hz = (int)((1000000000LL + period / 2) / period);
+        if (hz % fps == 0 && (best == 0 || hz < best)) {
+            best = hz;
+        }
+    }
+    return best;
+}
+
+bool RefreshRateGovernor::setRefreshRate(IDisplayDevice *device, int hz)
+{
+    ILOGTRACE("switching %s to %dHz", device->getName(), hz);
+    // the mode set blocks until the sink runs the new mode, keep it off prepare
+    static_cast<ExternalDevice*>(device)->requestRefreshRate(hz);
+    mLastSwitch = systemTime(SYSTEM_TIME_MONOTONIC);
+    return true;
+}
+
+void RefreshRateGovernor::revert(IDisplayDevice *device)
+{
+    setRefreshRate(device, mDefaultRate);
+    mState = STATE_DEFAULT;
+    mVideoRate = 0;
+    mReverts++;
+}
+
+void RefreshRateGovernor::analyze(size_t numDisplays, hwc_display_contents_1_t** displays)
+{
+    if (!mEnabled || numDisplays <= IDisplayDevice::DEVICE_EXTERNAL) {
+        return;
+    }
+
+    Mutex::Autolock _l(mLock);
+
+    hwc_display_contents_1_t *display = displays[IDisplayDevice::DEVICE_EXTERNAL];
+    IDisplayDevice *device =
+        Hwcomposer::getInstance().getDisplayDevice(IDisplayDevice::DEVICE_EXTERNAL);
+    if (!display || !device || !device->isConnected()) {
+        // a sink still connected keeps the switched mode without contents
+        if (mState == STATE_VIDEO && device && device->isConnected()) {
+            DLOGTRACE("no contents, reverting refresh rate");
+            revert(device);
+        }
+        mState = STATE_DEFAULT;
+        mLastHandles.clear();
+        return;
+    }
+
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    if (isUiUpdated(display)) {
+        mUiFrames = (now - mLastUiUpdate < UI_EXIT_WINDOW) ? mUiFrames + 1 : 1;
+        mLastUiUpdate = now;
+    }
+
+    bool videoActive = mVideoFps && (now - mLastVideoFrame < VIDEO_TIMEOUT);
+
+    if (mState == STATE_DEFAULT) {
+        if (!videoActive ||
+            now - mCadenceSince < ENTER_DELAY ||
+            now - mLastUiUpdate < ENTER_DELAY ||
+            now - mLastSwitch < MIN_SWITCH_INTERVAL) {
+            return;
+        }
+
+        int defaultRate = getDefaultRefreshRate(device);
+        int videoRate = findRefreshRate(device, mVideoFps);
+        if (!defaultRate || !videoRate || videoRate == defaultRate) {
+            // no better mode, don't evaluate again until cadence changes
+            mCadenceSince = now;
+            return;
+        }
+
+        if (setRefreshRate(device, videoRate)) {
+            mState = STATE_VIDEO;
+            mDefaultRate = defaultRate;
+            mVideoRate = videoRate;
+            mUiFrames = 0;
+            mSwitches++;
+        }
+        return;
+    }
+
+    // revert on sustained UI activity, end of video or cadence change
+    bool revertNeeded = false;
+    if (mUiFrames >= UI_EXIT_FRAMES && now - mLastUiUpdate < UI_EXIT_WINDOW) {
+        DLOGTRACE("UI activity, reverting refresh rate");
+        revertNeeded = true;
+    } else if (!videoActive) {
+        DLOGTRACE("video stopped, reverting refresh rate");
+        revertNeeded = true;
+    } else if (mVideoFps && mVideoRate % mVideoFps) {
+        DLOGTRACE("video cadence changed to %d fps, reverting refresh rate", mVideoFps);
+        revertNeeded = true;
+    }
+
+    if (revertNeeded) {
+        revert(device);
+    }
+}
+
+void RefreshRateGovernor::dump(Dump& d)
+{
+    Mutex::Autolock _l(mLock);
+
+    d.append("-------------------------------------------------------------\n");
+    d.append("Refresh rate governor: %s\n", mEnabled ? "enabled" : "disabled");
+    d.append("  state %s, video cadence %d fps\n",
+             mState == STATE_VIDEO ? "VIDEO" : "DEFAULT",
+             mVideoFps);
+    if (mState == STATE_VIDEO) {
+        d.append("  switched to %dHz from %dHz\n", mVideoRate, mDefaultRate);
+    }
+    d.append("  switches %u, reverts %u\n", mSwitches, mReverts);
+}
+
+} // namespace intel
+} // namespace android
@@ -0,0 +1,102 @@
+/*
+// Copyright (c) 2014 Intel Corporation 
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#ifndef REFRESH_RATE_GOVERNOR_H
+#define REFRESH_RATE_GOVERNOR_H
+
+#include <hardware/hwcomposer.h>
+#include <utils/threads.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
+#include <common/utils/Dump.h>
+
+namespace android {
+namespace intel {
+
+class IDisplayDevice;
+
+// Switches the external display to a refresh rate matching the cadence of
+// full screen video, and back to the active config on UI activity.
+class RefreshRateGovernor {
+public:
+    RefreshRateGovernor();
+    virtual ~RefreshRateGovernor();
+
+public:
+    bool initialize();
+    void deinitialize();
+    // a new video frame is flipped on an overlay of the given display
+    void onVideoFrame(int disp, int64_t timestamp);
+    // called at the beginning of each prepare
+    void analyze(size_t numDisplays, hwc_display_contents_1_t** displays);
+    void reset();
+    void dump(Dump& d);
+
+private:
+    enum {
+        STATE_DEFAULT = 0,
+        STATE_VIDEO,
+    };
+
+    enum {
+        CADENCE_SAMPLE_COUNT = 16,
+        // tolerance of frame interval to nominal cadence, in 1/1000
+        CADENCE_TOLERANCE = 20,
+        // allowed jitter of a single interval, in 1/1000
+        CADENCE_JITTER = 150,
+        // consecutive prepares with UI updates that revert the switch
+        UI_EXIT_FRAMES = 3,
+    };
+
+    int detectFrameRate();
+    bool isUiUpdated(hwc_display_contents_1_t *display);
+    bool isVideoLayer(hwc_layer_1_t& layer);
+    int getDefaultRefreshRate(IDisplayDevice *device);
+    int findRefreshRate(IDisplayDevice *device, int fps);
+    bool setRefreshRate(IDisplayDevice *device, int hz);
+    // back to the refresh rate active before the switch
+    void revert(IDisplayDevice *device);
+
+private:
+    bool mInitialized;
+    bool mEnabled;
+    int mState;
+
+    // video cadence, timestamps are in microseconds
+    int64_t mLastTimestamp;
+    int64_t mIntervals[CADENCE_SAMPLE_COUNT];
+    int mIntervalCount;
+    int mIntervalIndex;
+    int mVideoFps;
+    nsecs_t mCadenceSince;
+    nsecs_t mLastVideoFrame;
+
+    // UI activity
+    Vector<buffer_handle_t> mLastHandles;
+    nsecs_t mLastUiUpdate;
+    int mUiFrames;
+
+    int mDefaultRate;
+    int mVideoRate;
+    nsecs_t mLastSwitch;
+    uint32_t mSwitches;
+    uint32_t mReverts;
+    Mutex mLock;
+};
+
+} // namespace intel
+} // namespace android
+
+#endif /* REFRESH_RATE_GOVERNOR_H */
@@ -15,6 +15,7 @@
 */
 
 #include <common/utils/HwcTrace.h>
+#include <string.h>
 #include <hardware/hwcomposer.h>
 #include <BufferManager.h>
 #include <DrmConfig.h>
@@ -29,9 +30,13 @@ BufferManager::BufferManager()
       mBufferPool(NULL),
       mDataBuffer(NULL),
       mDataBufferLock(),
-      mInitialized(false)
+      mInitialized(false),
+      mMapAheadCurrent(0),
+      mMapAheadFrame(0),
+      mMapAheadExiting(false)
 {
     CTRACE();
+    memset(&mMapAheadStats, 0, sizeof(mMapAheadStats));
 }
 
 BufferManager::~BufferManager()
@@ -73,6 +78,11 @@ bool BufferManager::initialize()
         DEINIT_AND_RETURN_FALSE("failed to create data buffer");
     }
 
+    if (!startMapAhead()) {
+        // not fatal, buffers are mapped on first use
+        WLOGTRACE("failed to start map-ahead thread");
+    }
+
     mInitialized = true;
     return true;
 }
@@ -81,6 +91,8 @@ void BufferManager::deinitialize()
 {
     mInitialized = false;
 
+    stopMapAhead();
+
     if (mBufferPool) {
         // unmap & delete all cached buffer mappers
         for (size_t i = 0; i < mBufferPool->getCacheSize(); i++) {
@@ -125,6 +137,21 @@ void BufferManager::dump(Dump& d)
                  mapper->getFormat(),
                  mapper->getRef());
     }
+
+    Mutex::Autolock _l(mLock);
+    d.append("Map-ahead: queued %d, ready %d, requests %d, hits %d, "
+             "waits %d, steals %d, dropped %d, evictions %d, expirations %d, "
+             "failures %d\n",
+             mMapAheadQueue.size(),
+             mMapAheadReady.size(),
+             mMapAheadStats.queued,
+             mMapAheadStats.hits,
+             mMapAheadStats.waits,
+             mMapAheadStats.steals,
+             mMapAheadStats.dropped,
+             mMapAheadStats.evictions,
+             mMapAheadStats.expirations,
+             mMapAheadStats.failures);
     return;
 }
 
@@ -165,6 +192,37 @@ BufferMapper* BufferManager::map(DataBuffer& buffer)
         return mapper;
     }
 
+    // wait for the map-ahead thread rather than mapping it twice
+    if (mMapAheadCurrent && mMapAheadCurrent == buffer.getHandle()) {
+        mMapAheadStats.waits++;
+        while (mMapAheadCurrent && mMapAheadCurrent == buffer.getHandle()) {
+            mMapAheadDoneCond.wait(mLock);
+        }
+    }
+
+    // already mapped ahead
+    mapper = takeMapAheadMapper(buffer.getKey());
+    if (mapper) {
+        mMapAheadStats.hits++;
+        if (!mBufferPool->addMapper(buffer.getKey(), mapper)) {
+            ELOGTRACE("failed to add mapper");
+            mapper->unmap();
+            delete mapper;
+            return NULL;
+        }
+        mapper->incRef();
+        return mapper;
+    }
+
+    // still queued for map-ahead, map it here instead
+    for (size_t i = 0; i < mMapAheadQueue.size(); i++) {
+        if (mMapAheadQueue.itemAt(i) == buffer.getHandle()) {
+            mMapAheadQueue.removeAt(i);
+            mMapAheadStats.steals++;
+            break;
+        }
+    }
+
     // create a new buffer mapper and add it to pool
     do {
         VLOGTRACE("new buffer, will add it");
@@ -218,6 +276,209 @@ void BufferManager::unmap(BufferMapper *mapper)
     }
 }
 
+BufferMapper* BufferManager::takeMapAheadMapper(uint64_t key)
+{
+    for (size_t i = 0; i < mMapAheadReady.size(); i++) {
+        BufferMapper *mapper = mMapAheadReady.itemAt(i).mapper;
+        if (mapper->getKey() == key) {
+            mMapAheadReady.removeAt(i);
+            return mapper;
+        }
+    }
+    return NULL;
+}
+
+bool BufferManager::isMapAheadPending(uint32_t handle)
+{
+    if (mMapAheadCurrent == handle) {
+        return true;
+    }
+    for (size_t i = 0; i < mMapAheadQueue.size(); i++) {
+        if (mMapAheadQueue.itemAt(i) == handle) {
+            return true;
+        }
+    }
+    for (size_t i = 0; i < mMapAheadReady.size(); i++) {
+        if (mMapAheadReady.itemAt(i).mapper->getHandle() == handle) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool BufferManager::startMapAhead()
+{
+    mMapAheadExiting = false;
+    mMapAheadQueue.setCapacity(MAP_AHEAD_QUEUE_SIZE);
+    mMapAheadReady.setCapacity(MAP_AHEAD_READY_COUNT);
+    mMapAheadExpired.setCapacity(MAP_AHEAD_READY_COUNT);
+
+    mThread = new MapAheadThread(this);
+    if (!mThread.get()) {
+        return false;
+    }
+    if (mThread->run("MapAhead", PRIORITY_URGENT_DISPLAY) != NO_ERROR) {
+        mThread = NULL;
+        return false;
+    }
+    return true;
+}
+
+void BufferManager::stopMapAhead()
+{
+    if (mThread.get()) {
+        {
+            Mutex::Autolock _l(mLock);
+            mMapAheadExiting = true;
+            mMapAheadCond.signal();
+        }
+        mThread->requestExitAndWait();
+        mThread = NULL;
+    }
+
+    mMapAheadQueue.clear();
+
+    for (size_t i = 0; i < mMapAheadReady.size(); i++) {
+        BufferMapper *mapper = mMapAheadReady.itemAt(i).mapper;
+        mapper->unmap();
+        delete mapper;
+    }
+    mMapAheadReady.clear();
+
+    for (size_t i = 0; i < mMapAheadExpired.size(); i++) {
+        BufferMapper *mapper = mMapAheadExpired.itemAt(i);
+        mapper->unmap();
+        delete mapper;
+    }
+    mMapAheadExpired.clear();
+}
+
+void BufferManager::mapAhead(uint32_t handle)
+{
+    if (!mInitialized || !mThread.get() || !handle) {
+        return;
+    }
+
+    Mutex::Autolock _l(mLock);
+    if (isMapAheadPending(handle)) {
+        return;
+    }
+    if (mMapAheadQueue.size() >= MAP_AHEAD_QUEUE_SIZE) {
+        VLOGTRACE("map-ahead queue is full");
+        return;
+    }
+
+    // buffers already in the pool are skipped by the worker
+    mMapAheadQueue.push_back(handle);
+    mMapAheadStats.queued++;
+    mMapAheadCond.signal();
+}
+
+void BufferManager::expireMapAhead()
+{
+    if (!mInitialized || !mThread.get()) {
+        return;
+    }
+
+    Mutex::Autolock _l(mLock);
+    mMapAheadFrame++;
+
+    // handles are only guaranteed valid for the frame they were queued in
+    mMapAheadStats.dropped += mMapAheadQueue.size();
+    mMapAheadQueue.clear();
+
+    for (size_t i = 0; i < mMapAheadReady.size(); ) {
+        const MapAheadEntry& entry = mMapAheadReady.itemAt(i);
+        if (mMapAheadFrame - entry.frame > MAP_AHEAD_EXPIRE_FRAMES) {
+            mMapAheadExpired.push_back(entry.mapper);
+            mMapAheadReady.removeAt(i);
+            mMapAheadStats.expirations++;
+        } else {
+            i++;
+        }
+    }
+    if (mMapAheadExpired.size()) {
+        mMapAheadCond.signal();
+    }
+}
+
+bool BufferManager::threadLoop()
+{
+    uint32_t handle = 0;
+    Vector<BufferMapper*> expired;
+
+    {
+        Mutex::Autolock _l(mLock);
+        while (!mMapAheadExiting && mMapAheadQueue.isEmpty() &&
+               mMapAheadExpired.isEmpty()) {
+            mMapAheadCond.wait(mLock);
+        }
+        if (mMapAheadExiting) {
+            return false;
+        }
+        expired = mMapAheadExpired;
+        mMapAheadExpired.clear();
+        if (!mMapAheadQueue.isEmpty()) {
+            handle = mMapAheadQueue.itemAt(0);
+            mMapAheadQueue.removeAt(0);
+            mMapAheadCurrent = handle;
+        }
+    }
+
+    // the expensive parts, done without holding the lock
+    for (size_t i = 0; i < expired.size(); i++) {
+        BufferMapper *mapper = expired.itemAt(i);
+        mapper->unmap();
+        delete mapper;
+    }
+    if (!handle) {
+        return true;
+    }
+
+    // a private data buffer, map() may be waiting for this handle while
+    // its caller holds the shared one
+    BufferMapper *mapper = NULL;
+    bool mapped = false;
+    DataBuffer *buffer = get(handle);
+    if (buffer) {
+        {
+            Mutex::Autolock _l(mLock);
+            mapped = mBufferPool->getMapper(buffer->getKey()) != NULL;
+        }
+        if (!mapped) {
+            // the mapper owns a clone of the handle
+            mapper = createBufferMapper(mGrallocModule, *buffer);
+        }
+        put(buffer);
+    }
+    bool ret = mapper && mapper->map();
+
+    Mutex::Autolock _l(mLock);
+    mMapAheadCurrent = 0;
+    if (mapped) {
+        // already mapped on first use
+    } else if (!ret) {
+        WLOGTRACE("failed to map buffer ahead");
+        mMapAheadStats.failures++;
+        delete mapper;
+    } else {
+        // drop the oldest unused mapping
+        if (mMapAheadReady.size() >= MAP_AHEAD_READY_COUNT) {
+            BufferMapper *oldest = mMapAheadReady.itemAt(0).mapper;
+            mMapAheadReady.removeAt(0);
+            oldest->unmap();
+            delete oldest;
+            mMapAheadStats.evictions++;
+        }
+        MapAheadEntry entry;
+        entry.mapper = mapper;
+        entry.frame = mMapAheadFrame;
+        mMapAheadReady.push_back(entry);
+    }
+    mMapAheadDoneCond.broadcast();
+    return true;
+}
+
 uint32_t BufferManager::allocFrameBuffer(int width, int height, int *stride)
 {
     RETURN_NULL_IF_NOT_INIT();
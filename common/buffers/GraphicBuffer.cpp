@@ -55,7 +55,14 @@ bool GraphicBuffer::isCompressionUsage(uint32_t usage)
         return false;
     }
 
-    return false;
+    // CPU access always gets the linear layout
+    if (usage & (GRALLOC_USAGE_SW_READ_MASK | GRALLOC_USAGE_SW_WRITE_MASK)) {
+        return false;
+    }
+
+    // only GPU render targets can be laid out compressed, whether the
+    // format allows it is up to gralloc
+    return (usage & GRALLOC_USAGE_HW_RENDER) != 0;
 }
 
 bool GraphicBuffer::isCompressionBuffer(GraphicBuffer *buffer)
@@ -64,7 +71,7 @@ bool GraphicBuffer::isCompressionBuffer(GraphicBuffer *buffer)
         return false;
     }
 
-    return isCompressionUsage(buffer->mUsage);
+    return buffer->isCompression();
 }
 
 void GraphicBuffer::initBuffer(uint32_t /*handle*/)
@@ -13,7 +13,12 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 */
+#include <cutils/properties.h>
+#include <stdlib.h>
+#include <unistd.h>
 #include <common/utils/HwcTrace.h>
+#include <common/base/HwcLayerList.h>
+#include <common/planes/DummyPlaneManager.h>
 #include <Hwcomposer.h>
 #include <DisplayQuery.h>
 #include <common/observers/SoftVsyncObserver.h>
@@ -28,6 +33,18 @@ DummyDevice::DummyDevice(uint32_t type, Hwcomposer& hwc)
       mType(type),
       mHwc(hwc),
       mVsyncObserver(NULL),
+      mPlaneManager(NULL),
+      mLayerList(NULL),
+      mWidth(DEFAULT_WIDTH),
+      mHeight(DEFAULT_HEIGHT),
+      mRefreshRate(DEFAULT_REFRESH_RATE),
+      mSpritePlanes(DEFAULT_SPRITE_PLANES),
+      mOverlayPlanes(DEFAULT_OVERLAY_PLANES),
+      mFrameCount(0),
+      mOverlayLayerCount(0),
+      mFbLayerCount(0),
+      mFirstCommitTime(0),
+      mLastCommitTime(0),
       mName("Dummy")
 {
     CTRACE();
@@ -38,15 +55,34 @@ DummyDevice::~DummyDevice()
     WARN_IF_NOT_DEINIT();
 }
 
+bool DummyDevice::isHeadless() const
+{
+    return mPlaneManager && mConnected && !mBlank;
+}
+
 bool DummyDevice::prePrepare(hwc_display_contents_1_t *display)
 {
     RETURN_FALSE_IF_NOT_INIT();
 
-    if (!display) {
+    if (!mPlaneManager) {
+        // nothing need to do for dummy display
+        return true;
+    }
+
+    mPlaneManager->disableReclaimedPlanes();
+
+    // for a null list, delete hwc list
+    if (!isHeadless() || !display) {
+        if (mLayerList) {
+            DEINIT_AND_DELETE_OBJ(mLayerList);
+        }
         return true;
     }
 
-    // nothing need to do for dummy display
+    // check if geometry is changed, if changed delete list
+    if ((display->flags & HWC_GEOMETRY_CHANGED) && mLayerList) {
+        DEINIT_AND_DELETE_OBJ(mLayerList);
+    }
     return true;
 }
 
@@ -54,30 +90,64 @@ bool DummyDevice::prepare(hwc_display_contents_1_t *display)
 {
     RETURN_FALSE_IF_NOT_INIT();
 
-    if (!display || mType >= DEVICE_VIRTUAL) {
+    // only a headless display takes layers, those of a virtual display
+    // stay in GLES composition into its output buffer
+    if (!display || !isHeadless()) {
         return true;
     }
 
-    // skip all layers composition on dummy display
+    // allocate planes from the private plane manager as a physical
+    // display would, layers left without a plane go to the frame buffer
     if (display->flags & HWC_GEOMETRY_CHANGED) {
-        for (size_t i=0; i < display->numHwLayers-1; i++) {
-            hwc_layer_1 * player = &display->hwLayers[i];
-            player->compositionType = HWC_OVERLAY;
-            player->flags &= ~HWC_SKIP_LAYER;
+        mLayerList = new HwcLayerList(display, mType, mPlaneManager);
+        if (!mLayerList) {
+            WLOGTRACE("failed to create layer list");
+            return true;
         }
     }
+    if (!mLayerList) {
+        WLOGTRACE("null HWC layer list");
+        return true;
+    }
 
-    return true;
+    bool ret = mLayerList->update(display);
+
+    mOverlayLayerCount = 0;
+    mFbLayerCount = 0;
+    for (size_t i = 0; i + 1 < display->numHwLayers; i++) {
+        if (display->hwLayers[i].compositionType == HWC_FRAMEBUFFER) {
+            mFbLayerCount++;
+        } else {
+            mOverlayLayerCount++;
+        }
+    }
+    return ret;
 }
 
 bool DummyDevice::commit(hwc_display_contents_1_t *display, IDisplayContext *context)
 {
     RETURN_FALSE_IF_NOT_INIT();
 
-    if (!display || !context)
+    if (!display || !context || !mLayerList)
         return true;
 
-    // nothing need to do for dummy display
+    // nothing is scanned out, buffers are released right away
+    for (size_t i = 0; i < display->numHwLayers; i++) {
+        hwc_layer_1_t& layer = display->hwLayers[i];
+        if (layer.acquireFenceFd != -1) {
+            close(layer.acquireFenceFd);
+            layer.acquireFenceFd = -1;
+        }
+        layer.releaseFenceFd = -1;
+    }
+    mLayerList->postFlip();
+
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    if (!mFrameCount) {
+        mFirstCommitTime = now;
+    }
+    mLastCommitTime = now;
+    mFrameCount++;
     return true;
 }
 
@@ -104,9 +174,8 @@ bool DummyDevice::getDisplaySize(int *width, int *height)
         return false;
     }
 
-    // TODO: make this platform specifc
-    *width = 1280;//720;
-    *height = 720;//1280;
+    *width = mWidth;
+    *height = mHeight;
     return true;
 }
 
@@ -150,13 +219,13 @@ bool DummyDevice::getDisplayAttributes(uint32_t configs,
     while (attributes[i] != HWC_DISPLAY_NO_ATTRIBUTE) {
         switch (attributes[i]) {
         case HWC_DISPLAY_VSYNC_PERIOD:
-            values[i] = 1e9 / 60;
+            values[i] = 1e9 / mRefreshRate;
             break;
         case HWC_DISPLAY_WIDTH:
-            values[i] = 1280;
+            values[i] = mWidth;
             break;
         case HWC_DISPLAY_HEIGHT:
-            values[i] = 720;
+            values[i] = mHeight;
             break;
         case HWC_DISPLAY_DPI_X:
             values[i] = 0;
@@ -180,19 +249,117 @@ bool DummyDevice::compositionComplete()
     return true;
 }
 
+bool DummyDevice::isHeadlessEnabled()
+{
+    char prop[PROPERTY_VALUE_MAX];
+    return property_get("debug.hwc.dummy.connected", prop, "0") > 0 && atoi(prop);
+}
+
+void DummyDevice::loadConfig()
+{
+    char prop[PROPERTY_VALUE_MAX];
+
+    // Virtual displays belong to SurfaceFlinger and are composed into
+    // their output buffer, they can't be headless
+    if (isHeadlessEnabled()) {
+        if (mType < DEVICE_VIRTUAL) {
+            mConnected = true;
+        } else {
+            WLOGTRACE("dummy display %d is virtual, can't be headless", mType);
+        }
+    }
+
+    if (property_get("debug.hwc.dummy.width", prop, NULL) > 0) {
+        int width = atoi(prop);
+        int height = 0;
+        if (property_get("debug.hwc.dummy.height", prop, NULL) > 0) {
+            height = atoi(prop);
+        }
+        if (width > 0 && height > 0) {
+            mWidth = width;
+            mHeight = height;
+        } else {
+            WLOGTRACE("invalid dummy display size %dx%d", width, height);
+        }
+    }
+
+    if (property_get("debug.hwc.dummy.refresh", prop, NULL) > 0) {
+        int rate = atoi(prop);
+        // same limits as the soft vsync
+        if (rate >= 1 && rate <= 120) {
+            mRefreshRate = rate;
+        } else {
+            WLOGTRACE("invalid dummy display refresh rate %d", rate);
+        }
+    }
+
+    if (property_get("debug.hwc.dummy.sprites", prop, NULL) > 0) {
+        int planes = atoi(prop);
+        if (planes >= 0 && planes <= MAX_DUMMY_PLANES) {
+            mSpritePlanes = planes;
+        } else {
+            WLOGTRACE("invalid dummy display sprite count %d", planes);
+        }
+    }
+
+    if (property_get("debug.hwc.dummy.overlays", prop, NULL) > 0) {
+        int planes = atoi(prop);
+        if (planes >= 0 && planes <= MAX_DUMMY_PLANES) {
+            mOverlayPlanes = planes;
+        } else {
+            WLOGTRACE("invalid dummy display overlay count %d", planes);
+        }
+    }
+
+    ILOGTRACE("dummy display %d: %s, %dx%d@%d, %d sprites, %d overlays", mType,
+        mConnected ? "connected" : "disconnected",
+        mWidth, mHeight, mRefreshRate, mSpritePlanes, mOverlayPlanes);
+}
+
 bool DummyDevice::initialize()
 {
     mInitialized = true;
 
+    loadConfig();
+
     mVsyncObserver = new SoftVsyncObserver(*this);
     if (!mVsyncObserver || !mVsyncObserver->initialize()) {
         DEINIT_AND_RETURN_FALSE("Failed to create Soft Vsync Observer");
         mInitialized = false;
     }
+    mVsyncObserver->setRefreshRate(mRefreshRate);
+
+    if (mConnected) {
+        mPlaneManager = new DummyPlaneManager(mSpritePlanes, mOverlayPlanes);
+        if (!mPlaneManager || !mPlaneManager->initialize()) {
+            DEINIT_AND_RETURN_FALSE("failed to create dummy plane manager");
+        }
+
+        // no uevent announces the headless display, SurfaceFlinger creates
+        // it from the hotplug sent once its callbacks are registered
+        mThread = new HotplugThread(this);
+        if (!mThread.get() ||
+            mThread->run("DummyHotplug", PRIORITY_URGENT_DISPLAY) != NO_ERROR) {
+            mThread = NULL;
+            DEINIT_AND_RETURN_FALSE("failed to start hotplug thread");
+        }
+    }
 
     return mInitialized;
 }
 
+bool DummyDevice::threadLoop()
+{
+    // woken up regularly so deinitialize doesn't wait for SurfaceFlinger
+    if (!mHwc.waitForProcs(ms2ns(PROCS_WAIT_MS))) {
+        return true;
+    }
+
+    ILOGTRACE("reporting headless display %d", mType);
+    mHwc.headlessHotplug(mType, true);
+    return false;
+}
+
 bool DummyDevice::isConnected() const
 {
     return mConnected;
@@ -221,10 +388,37 @@ void DummyDevice::dump(Dump& d)
     d.append("-------------------------------------------------------------\n");
     d.append("Device Name: %s (%s)\n", mName,
             mConnected ? "connected" : "disconnected");
+    if (!mConnected) {
+        return;
+    }
+
+    d.append("Config: %dx%d@%d, %d sprites, %d overlays\n",
+            mWidth, mHeight, mRefreshRate, mSpritePlanes, mOverlayPlanes);
+    d.append("Layers: %d on planes, %d framebuffer\n",
+            mOverlayLayerCount, mFbLayerCount);
+
+    nsecs_t elapsed = mLastCommitTime - mFirstCommitTime;
+    float fps = 0;
+    if (mFrameCount > 1 && elapsed > 0) {
+        fps = (mFrameCount - 1) * 1e9f / elapsed;
+    }
+    d.append("Frames: %d, %.2f fps\n", mFrameCount, fps);
+
+    if (mLayerList) {
+        mLayerList->dump(d);
+    }
 }
 
 void DummyDevice::deinitialize()
 {
+    if (mThread.get()) {
+        mThread->requestExitAndWait();
+        mThread = NULL;
+    }
+    if (mLayerList) {
+        DEINIT_AND_DELETE_OBJ(mLayerList);
+    }
+    DEINIT_AND_DELETE_OBJ(mPlaneManager);
     DEINIT_AND_DELETE_OBJ(mVsyncObserver);
     mInitialized = false;
 }
@@ -15,6 +15,7 @@
 */
 
 #include <common/utils/HwcTrace.h>
+#include <common/utils/HwcMetrics.h>
 #include <common/base/Drm.h>
 #include <DrmConfig.h>
 #include <Hwcomposer.h>
@@ -26,10 +27,20 @@ namespace intel {
 ExternalDevice::ExternalDevice(Hwcomposer& hwc, DisplayPlaneManager& dpm)
     : PhysicalDevice(DEVICE_EXTERNAL, hwc, dpm),
       mHdcpControl(NULL),
-      mAbortModeSettingCond(),
+      mModeSettingCond(),
+      mWaitingUnplugAck(false),
+      mUnplugAcked(false),
+      mModeSettingAborted(false),
       mPendingDrmMode(),
+      mDrmModePending(false),
+      mRefreshRatePending(false),
+      mPendingRefreshRate(0),
+      mThreadRunning(false),
       mHotplugEventPending(false),
-      mExpectedRefreshRate(0)
+      mExpectedRefreshRate(0),
+      mPlugTime(0),
+      mLastModeSetTime(0),
+      mLastPlugToFrameTime(0)
 {
     CTRACE();
 }
@@ -52,6 +63,10 @@ bool ExternalDevice::initialize()
 
     mHotplugEventPending = false;
     if (mConnected) {
+        {
+            Mutex::Autolock lock(mLock);
+            mPlugTime = systemTime(SYSTEM_TIME_MONOTONIC);
+        }
         mHdcpControl->startHdcpAsync(HdcpLinkStatusListener, this);
     }
 
@@ -70,11 +85,24 @@ bool ExternalDevice::initialize()
 void ExternalDevice::deinitialize()
 {
     // abort mode settings if it is in the middle
-    mAbortModeSettingCond.signal();
-    if (mThread.get()) {
-        mThread->join();
+    {
+        Mutex::Autolock lock(mLock);
+        if (mWaitingUnplugAck) {
+            mModeSettingAborted = true;
+            mModeSettingCond.signal();
+        }
+        mDrmModePending = false;
+        mRefreshRatePending = false;
+    }
+    sp<ModeSettingThread> thread;
+    {
+        Mutex::Autolock lock(mLock);
+        thread = mThread;
         mThread = NULL;
     }
+    if (thread.get()) {
+        thread->join();
+    }
 
     if (mHdcpControl) {
         mHdcpControl->stopHdcp();
@@ -86,6 +114,42 @@ void ExternalDevice::deinitialize()
     PhysicalDevice::deinitialize();
 }
 
+bool ExternalDevice::prePrepare(hwc_display_contents_1_t *display)
+{
+    // surface flinger stops sending contents once it handled the hot unplug
+    if (!display) {
+        Mutex::Autolock lock(mLock);
+        if (mWaitingUnplugAck && !mUnplugAcked) {
+            mUnplugAcked = true;
+            mModeSettingCond.signal();
+        }
+    }
+
+    return PhysicalDevice::prePrepare(display);
+}
+
+bool ExternalDevice::commit(hwc_display_contents_1_t *display,
+                              IDisplayContext *context)
+{
+    if (display && mConnected && !mBlank) {
+        nsecs_t elapsed = 0;
+        {
+            Mutex::Autolock lock(mLock);
+            if (mPlugTime) {
+                elapsed = systemTime(SYSTEM_TIME_MONOTONIC) - mPlugTime;
+                mLastPlugToFrameTime = elapsed;
+                mPlugTime = 0;
+            }
+        }
+        if (elapsed) {
+            HwcMetrics::record(HwcMetrics::PHASE_PLUG_TO_FRAME, elapsed);
+            DLOGTRACE("first frame %lld ms after plug", ns2ms(elapsed));
+        }
+    }
+
+    return PhysicalDevice::commit(display, context);
+}
+
 bool ExternalDevice::blank(bool blank)
 {
     if (!PhysicalDevice::blank(blank)) {
@@ -107,9 +171,14 @@ bool ExternalDevice::setDrmMode(drmModeModeInfo& value)
         return false;
     }
 
-    if (mThread.get()) {
-        mThread->join();
-        mThread = NULL;
+    // wait for the previous mode setting to finish
+    sp<ModeSettingThread> thread;
+    {
+        Mutex::Autolock lock(mLock);
+        thread = mThread;
+    }
+    if (thread.get()) {
+        thread->join();
     }
 
     Drm *drm = Hwcomposer::getInstance().getDrm();
@@ -120,24 +189,72 @@ bool ExternalDevice::setDrmMode(drmModeModeInfo& value)
 
     // any issue here by faking connection status?
     mConnected = false;
-    mPendingDrmMode = value;
 
     // setting mode in a working thread
+    Mutex::Autolock lock(mLock);
+    mPendingDrmMode = value;
+    mDrmModePending = true;
+    return startModeSettingThread();
+}
+
+bool ExternalDevice::startModeSettingThread()
+{
+    if (mThreadRunning) {
+        // the running thread checks for new work before it exits
+        return true;
+    }
+
+    // a previous thread has exited or is about to, it is not waited for
     mThread = new ModeSettingThread(this);
     if (!mThread.get()) {
         ELOGTRACE("failed to create mode settings thread");
+        mDrmModePending = false;
+        mRefreshRatePending = false;
         return false;
     }
 
+    mThreadRunning = true;
     mThread->run("ModeSettingsThread", PRIORITY_URGENT_DISPLAY);
     return true;
 }
 
 bool ExternalDevice::threadLoop()
 {
-    // one-time execution
-    setDrmMode();
-    return false;
+    bool drmModePending;
+    bool refreshRatePending;
+    int hz;
+
+    {
+        Mutex::Autolock lock(mLock);
+        drmModePending = mDrmModePending;
+        refreshRatePending = mRefreshRatePending;
+        hz = mPendingRefreshRate;
+        mDrmModePending = false;
+        mRefreshRatePending = false;
+        if (!drmModePending && !refreshRatePending) {
+            mThreadRunning = false;
+            return false;
+        }
+    }
+
+    if (drmModePending) {
+        setDrmMode();
+    }
+    if (refreshRatePending) {
+        setRefreshRate(hz);
+    }
+    return true;
+}
+
+void ExternalDevice::requestRefreshRate(int hz)
+{
+    RETURN_VOID_IF_NOT_INIT();
+
+    Mutex::Autolock lock(mLock);
+    // only the latest request matters
+    mPendingRefreshRate = hz;
+    mRefreshRatePending = true;
+    startModeSettingThread();
 }
 
 void ExternalDevice::setDrmMode()
@@ -145,20 +262,40 @@ void ExternalDevice::setDrmMode()
     ILOGTRACE("start mode setting...");
 
     Drm *drm = Hwcomposer::getInstance().getDrm();
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    {
+        Mutex::Autolock lock(mLock);
+        mWaitingUnplugAck = true;
+        mUnplugAcked = false;
+        mModeSettingAborted = false;
+    }
 
     mConnected = false;
     mHwc.hotplug(mType, false);
 
     {
         Mutex::Autolock lock(mLock);
-        // TODO: make timeout value flexible, or wait until surface flinger
-        // acknowledges hot unplug event.
-        status_t err = mAbortModeSettingCond.waitRelative(mLock, milliseconds(20));
-        if (err != -ETIMEDOUT) {
+        // proceed as soon as surface flinger drops the display, the timeout
+        // covers the case it has nothing to compose
+        nsecs_t deadline = start + milliseconds(UNPLUG_ACK_TIMEOUT_MS);
+        while (!mUnplugAcked && !mModeSettingAborted) {
+            nsecs_t remaining = deadline - systemTime(SYSTEM_TIME_MONOTONIC);
+            if (remaining <= 0) {
+                break;
+            }
+            mModeSettingCond.waitRelative(mLock, remaining);
+        }
+        mWaitingUnplugAck = false;
+
+        if (mModeSettingAborted) {
             ILOGTRACE("Mode settings is interrupted");
             mHwc.hotplug(mType, true);
             return;
         }
+        if (!mUnplugAcked) {
+            VLOGTRACE("hot unplug is not acknowledged, continue");
+        }
     }
 
     // TODO: potential threading issue with onHotplug callback
@@ -169,6 +306,15 @@ void ExternalDevice::setDrmMode()
         return;
     }
 
+    // the mode set ioctl returns once the new mode is running
+    nsecs_t elapsed = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+    HwcMetrics::record(HwcMetrics::PHASE_MODE_SET, elapsed);
+    {
+        Mutex::Autolock lock(mLock);
+        mLastModeSetTime = elapsed;
+        mPlugTime = start;
+    }
+
     if (!PhysicalDevice::updateDisplayConfigs()) {
         ELOGTRACE("failed to update display configs");
         mHwc.hotplug(mType, true);
@@ -220,7 +366,13 @@ void ExternalDevice::hotplugListener()
     CTRACE();
 
     // abort mode settings if it is in the middle
-    mAbortModeSettingCond.signal();
+    {
+        Mutex::Autolock lock(mLock);
+        if (mWaitingUnplugAck) {
+            mModeSettingAborted = true;
+            mModeSettingCond.signal();
+        }
+    }
 
     // remember the current connection status before detection
     bool connected = mConnected;
@@ -241,9 +393,17 @@ void ExternalDevice::hotplugListener()
 
     if (mConnected == false) {
         mHotplugEventPending = false;
+        {
+            Mutex::Autolock lock(mLock);
+            mPlugTime = 0;
+        }
         mHdcpControl->stopHdcp();
         mHwc.hotplug(mType, mConnected);
     } else {
+        {
+            Mutex::Autolock lock(mLock);
+            mPlugTime = systemTime(SYSTEM_TIME_MONOTONIC);
+        }
         DLOGTRACE("start HDCP asynchronously...");
         // delay sending hotplug event till HDCP is authenticated.
         mHotplugEventPending = true;
@@ -288,12 +448,15 @@ void ExternalDevice::setRefreshRate(int hz)
 
     ILOGTRACE("changing refresh rate from %d to %d", mode.vrefresh, hz);
 
-    mHdcpControl->stopHdcp();
+    // keep HDCP session across the refresh rate change
+    bool suspended = mHdcpControl->suspendHdcp();
 
     drm->setRefreshRate(IDisplayDevice::DEVICE_EXTERNAL, hz);
 
     mHotplugEventPending = false;
-    mHdcpControl->startHdcpAsync(HdcpLinkStatusListener, this);
+    if (!suspended || !mHdcpControl->resumeHdcp()) {
+        mHdcpControl->startHdcpAsync(HdcpLinkStatusListener, this);
+    }
 }
 
 
@@ -370,6 +533,24 @@ bool ExternalDevice::getDisplayAttributes(uint32_t config,
 #endif
 }
 
+void ExternalDevice::dump(Dump& d)
+{
+    PhysicalDevice::dump(d);
+
+    nsecs_t modeSetTime, plugToFrameTime;
+    {
+        Mutex::Autolock lock(mLock);
+        modeSetTime = mLastModeSetTime;
+        plugToFrameTime = mLastPlugToFrameTime;
+    }
+    d.append("Last mode set: %lld ms, plug to first frame: %lld ms\n",
+             ns2ms(modeSetTime), ns2ms(plugToFrameTime));
+
+    if (mHdcpControl) {
+        mHdcpControl->dump(d);
+    }
+}
+
 int ExternalDevice::getActiveConfig()
 {
     if (!mConnected) {
@@ -388,10 +569,11 @@ bool ExternalDevice::setActiveConfig(int index)
     }
 
     // for now we will only permit the frequency change.  In the future
-    // we may need to set mode as well.
+    // we may need to set mode as well. Queued to the mode setting thread
+    // so it never races a mode set or a refresh rate switch
     if (index >= 0 && index < static_cast<int>(mDisplayConfigs.size())) {
         DisplayConfig *config = mDisplayConfigs.itemAt(index);
-        setRefreshRate(config->getRefreshRate());
+        requestRefreshRate(config->getRefreshRate());
         mActiveDisplayConfig = index;
         return true;
     } else {
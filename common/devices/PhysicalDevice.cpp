@@ -14,6 +14,7 @@
 // limitations under the License.
 */
 #include <common/utils/HwcTrace.h>
+#include <common/utils/HwcMetrics.h>
 #include <Hwcomposer.h>
 #include <common/base/Drm.h>
 #include <PhysicalDevice.h>
@@ -63,6 +64,7 @@ void PhysicalDevice::onGeometryChanged(hwc_display_contents_1_t *list)
     }
 
     ALOGTRACE("disp = %d, layer number = %d", mType, list->numHwLayers);
+    HwcMetrics::increase(HwcMetrics::COUNTER_GEOMETRY_CHANGES);
 
     // NOTE: should NOT be here
     if (mLayerList) {
@@ -456,6 +458,14 @@ int PhysicalDevice::getType() const
     return mType;
 }
 
+bool PhysicalDevice::getVsyncModel(nsecs_t& period, nsecs_t& lastVsync) const
+{
+    if (!mVsyncObserver || !mConnected) {
+        return false;
+    }
+    return mVsyncObserver->getVsyncModel(period, lastVsync);
+}
+
 void PhysicalDevice::onVsync(int64_t timestamp)
 {
     RETURN_VOID_IF_NOT_INIT();
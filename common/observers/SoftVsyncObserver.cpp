@@ -13,6 +13,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 */
+#include <sys/prctl.h>
 #include <common/utils/HwcTrace.h>
 #include <common/observers/SoftVsyncObserver.h>
 #include <IDisplayDevice.h>
@@ -33,7 +34,10 @@ SoftVsyncObserver::SoftVsyncObserver(IDisplayDevice& disp)
       mRefreshPeriod(0),
       mLock(),
       mCondition(),
-      mNextFakeVSync(0),
+      mAnchor(0),
+      mPhaseLocked(false),
+      mLastVsync(0),
+      mSlackSet(false),
       mExitThread(false),
       mInitialized(false)
 {
@@ -54,6 +58,9 @@ bool SoftVsyncObserver::initialize()
     mExitThread = false;
     mEnabled = false;
     mRefreshRate = 60;
+    mPhaseLocked = false;
+    mLastVsync = 0;
+    mSlackSet = false;
     mDevice = mDisplayDevice.getType();
     mThread = new VsyncEventPollThread(this);
     if (!mThread.get()) {
@@ -71,8 +78,11 @@ void SoftVsyncObserver::deinitialize()
         control(false);
     }
 
-    mExitThread = true;
-    mCondition.signal();
+    {
+        Mutex::Autolock _l(mLock);
+        mExitThread = true;
+        mCondition.signal();
+    }
 
     if (mThread.get()) {
         mThread->requestExitAndWait();
@@ -89,50 +99,88 @@ void SoftVsyncObserver::setRefreshRate(int rate)
         WLOGTRACE("invalid refresh rate %d", rate);
     } else {
         mRefreshRate = rate;
+        mPhaseLocked = false;
+    }
+}
+
+void SoftVsyncObserver::setPhase(nsecs_t period, nsecs_t reference)
+{
+    if (period <= 0) {
+        WLOGTRACE("invalid vsync period %lld", period);
+        return;
     }
+
+    Mutex::Autolock _l(mLock);
+    mRefreshPeriod = period;
+    mAnchor = reference;
+    mPhaseLocked = true;
+}
+
+nsecs_t SoftVsyncObserver::getLastVsync() const
+{
+    Mutex::Autolock _l(mLock);
+    return mLastVsync;
 }
 
 bool SoftVsyncObserver::control(bool enabled)
 {
+    Mutex::Autolock _l(mLock);
     if (enabled == mEnabled) {
         WLOGTRACE("vsync state %d is not changed", enabled);
         return true;
     }
 
-    if (enabled) {
+    if (enabled && !mPhaseLocked) {
         mRefreshPeriod = nsecs_t(1e9 / mRefreshRate);
-        mNextFakeVSync = systemTime(CLOCK_MONOTONIC) + mRefreshPeriod;
+        mAnchor = systemTime(CLOCK_MONOTONIC);
     }
     mEnabled = enabled;
     mCondition.signal();
     return true;
 }
 
+nsecs_t SoftVsyncObserver::getNextVsyncLocked(nsecs_t now) const
+{
+    // computed from the anchor every time so errors don't accumulate
+    const nsecs_t period = mRefreshPeriod;
+    nsecs_t next;
+    if (now < mAnchor) {
+        next = mAnchor;
+    } else {
+        next = mAnchor + ((now - mAnchor) / period + 1) * period;
+    }
+
+    // never report two vsyncs closer than half a period, which can
+    // happen right after re-phasing
+    if (mLastVsync && next - mLastVsync < period / 2) {
+        next += period;
+    }
+    return next;
+}
+
 bool SoftVsyncObserver::threadLoop()
 {
+    if (!mSlackSet) {
+        // let the kernel coalesce our wakeups with other timers
+        if (prctl(PR_SET_TIMERSLACK, TIMER_SLACK_NS) < 0) {
+            WLOGTRACE("failed to set timer slack");
+        }
+        mSlackSet = true;
+    }
+
+    nsecs_t next_vsync;
     { // scope for lock
         Mutex::Autolock _l(mLock);
-        while (!mEnabled) {
+        while (!mEnabled && !mExitThread) {
             mCondition.wait(mLock);
-            if (mExitThread) {
-                ILOGTRACE("exiting thread loop");
-                return false;
-            }
         }
+        if (mExitThread) {
+            ILOGTRACE("exiting thread loop");
+            return false;
+        }
+        next_vsync = getNextVsyncLocked(systemTime(CLOCK_MONOTONIC));
     }
 
-
-    const nsecs_t period = mRefreshPeriod;
-    const nsecs_t now = systemTime(CLOCK_MONOTONIC);
-    nsecs_t next_vsync = mNextFakeVSync;
-    nsecs_t sleep = next_vsync - now;
-    if (sleep < 0) {
-        // we missed, find where the next vsync should be
-        sleep = (period - ((now - next_vsync) % period));
-        next_vsync = now + sleep;
-    }
-    mNextFakeVSync = next_vsync + period;
-
     struct timespec spec;
     spec.tv_sec  = next_vsync / 1000000000;
     spec.tv_nsec = next_vsync % 1000000000;
@@ -142,11 +190,20 @@ bool SoftVsyncObserver::threadLoop()
         err = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &spec, NULL);
     } while (err < 0 && errno == EINTR);
 
+    if (err != 0) {
+        return true;
+    }
 
-    if (err == 0) {
-        mDisplayDevice.onVsync(next_vsync);
+    { // scope for lock
+        Mutex::Autolock _l(mLock);
+        // disabled or re-phased while sleeping
+        if (!mEnabled || getNextVsyncLocked(next_vsync - 1) != next_vsync) {
+            return true;
+        }
+        mLastVsync = next_vsync;
     }
 
+    mDisplayDevice.onVsync(next_vsync);
     return true;
 }
 
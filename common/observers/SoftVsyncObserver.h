@@ -33,8 +33,20 @@ public:
     virtual void deinitialize();
     virtual void setRefreshRate(int rate);
     virtual bool control(bool enabled);
+    // align soft vsync to a measured period and a past vsync timestamp
+    void setPhase(nsecs_t period, nsecs_t reference);
+    nsecs_t getLastVsync() const;
 
 private:
+    nsecs_t getNextVsyncLocked(nsecs_t now) const;
+
+private:
+    // wakeups may be coalesced by this much, the reported timestamp
+    // is the ideal one regardless
+    enum {
+        TIMER_SLACK_NS = 200000,
+    };
+
     IDisplayDevice& mDisplayDevice;
     int  mDevice;
     bool mEnabled;
@@ -42,7 +54,11 @@ private:
     nsecs_t mRefreshPeriod;
     mutable Mutex mLock;
     Condition mCondition;
-    mutable nsecs_t mNextFakeVSync;
+    // vsyncs happen at mAnchor + n * mRefreshPeriod
+    nsecs_t mAnchor;
+    bool mPhaseLocked;
+    nsecs_t mLastVsync;
+    bool mSlackSet;
     bool mExitThread;
     bool mInitialized;
 
@@ -20,6 +20,7 @@
 #include <linux/netlink.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <string.h>
 #include <DrmConfig.h>
 #include <common/utils/HwcTrace.h>
 #include <UeventObserver.h>
@@ -31,6 +32,8 @@ UeventObserver::UeventObserver()
     : mUeventFd(-1),
       mExitRDFd(-1),
       mExitWDFd(-1),
+      mEnvelope(NULL),
+      mEnvelopeLength(0),
       mListeners()
 {
 }
@@ -82,6 +85,9 @@ bool UeventObserver::initialize()
 
     memset(mUeventMessage, 0, UEVENT_MSG_LEN);
 
+    mEnvelope = DrmConfig::getUeventEnvelope();
+    mEnvelopeLength = strlen(mEnvelope);
+
     int exitFds[2];
     if (pipe(exitFds) < 0) {
         ELOGTRACE("failed to make pipe");
@@ -132,8 +138,9 @@ void UeventObserver::registerListener(const char *event, UeventListenerFunc func
         return;
     }
 
-    String8 key(event);
+    uint32_t key = hashString(event, NULL);
     if (mListeners.indexOfKey(key) >= 0) {
+        // either registered twice or a hash collision, both are bugs
         ELOGTRACE("listener for uevent %s exists", event);
         return;
     }
@@ -143,6 +150,7 @@ void UeventObserver::registerListener(const char *event, UeventListenerFunc func
         ELOGTRACE("failed to create Uevent Listener");
         return;
     }
+    listener->event = String8(event);
     listener->func = func;
     listener->data = data;
 
@@ -170,7 +178,7 @@ bool UeventObserver::threadLoop()
     if (nr > 0 && fds[0].revents == POLLIN) {
         int count = recv(mUeventFd, mUeventMessage, UEVENT_MSG_LEN - 2, 0);
         if (count > 0) {
-            onUevent();
+            onUevent(count);
         }
     } else if (fds[1].revents) {
         close(mExitRDFd);
@@ -182,29 +190,52 @@ bool UeventObserver::threadLoop()
     return true;
 }
 
-void UeventObserver::onUevent()
+// FNV-1a, also returns the string length so callers don't rescan it
+uint32_t UeventObserver::hashString(const char *str, size_t *length)
+{
+    uint32_t hash = 2166136261u;
+    const char *p = str;
+
+    while (*p) {
+        hash ^= (uint8_t)*p++;
+        hash *= 16777619u;
+    }
+
+    if (length) {
+        *length = p - str;
+    }
+    return hash;
+}
+
+void UeventObserver::onUevent(int length)
 {
     char *msg = mUeventMessage;
-    const char *envelope = DrmConfig::getUeventEnvelope();
-    if (strncmp(msg, envelope, strlen(envelope)) != 0)
+    char *end = mUeventMessage + length;
+
+    // nobody listens, or not from our drm device
+    if (mListeners.isEmpty() ||
+        (size_t)length <= mEnvelopeLength ||
+        memcmp(msg, mEnvelope, mEnvelopeLength) != 0) {
         return;
+    }
 
-    msg += strlen(msg) + 1;
+    // message is a list of NUL separated strings, parse it in place
+    *end = '\0';
+    msg += strnlen(msg, end - msg) + 1;
 
-    UeventListener *listener;
-    String8 key;
-    while (*msg) {
-        key = String8(msg);
-        if (mListeners.indexOfKey(key) >= 0) {
-            DLOGTRACE("received Uevent: %s", msg);
-            listener = mListeners.valueFor(key);
-            if (listener) {
+    size_t len;
+    while (msg < end && *msg) {
+        uint32_t key = hashString(msg, &len);
+        ssize_t index = mListeners.indexOfKey(key);
+        if (index >= 0) {
+            UeventListener *listener = mListeners.valueAt(index);
+            if (listener && listener->event.length() == len &&
+                memcmp(listener->event.string(), msg, len) == 0) {
+                DLOGTRACE("received Uevent: %s", msg);
                 listener->func(listener->data);
-            } else {
-                ELOGTRACE("no listener for uevent %s", msg);
             }
         }
-        msg += strlen(msg) + 1;
+        msg += len + 1;
     }
 }
 
@@ -15,6 +15,7 @@
 */
 #include <common/utils/HwcTrace.h>
 #include <common/observers/VsyncEventObserver.h>
+#include <common/observers/SoftVsyncObserver.h>
 #include <PhysicalDevice.h>
 
 namespace android {
@@ -28,7 +29,12 @@ VsyncEventObserver::VsyncEventObserver(PhysicalDevice& disp)
       mDevice(IDisplayDevice::DEVICE_COUNT),
       mEnabled(false),
       mExitThread(false),
-      mInitialized(false)
+      mInitialized(false),
+      mSoftVsync(NULL),
+      mSoftVsyncActive(false),
+      mPeriod(0),
+      mLastHwVsync(0),
+      mRejectedSamples(0)
 {
     CTRACE();
 }
@@ -53,6 +59,15 @@ bool VsyncEventObserver::initialize()
         DEINIT_AND_RETURN_FALSE("failed to initialize vsync control");
     }
 
+    mSoftVsyncActive = false;
+    mPeriod = 0;
+    mLastHwVsync = 0;
+    mRejectedSamples = 0;
+    mSoftVsync = new SoftVsyncObserver(mDisplayDevice);
+    if (!mSoftVsync || !mSoftVsync->initialize()) {
+        DEINIT_AND_RETURN_FALSE("failed to initialize soft vsync");
+    }
+
     mThread = new VsyncEventPollThread(this);
     if (!mThread.get()) {
         DEINIT_AND_RETURN_FALSE("failed to create vsync event poll thread.");
@@ -80,9 +95,30 @@ void VsyncEventObserver::deinitialize()
         mThread = NULL;
     }
 
+    mSoftVsyncActive = false;
+    DEINIT_AND_DELETE_OBJ(mSoftVsync);
     DEINIT_AND_DELETE_OBJ(mVsyncControl);
 }
 
+bool VsyncEventObserver::getVsyncModel(nsecs_t& period, nsecs_t& lastVsync) const
+{
+    Mutex::Autolock _l(mLock);
+
+    if (!mEnabled || !mPeriod) {
+        return false;
+    }
+
+    period = mPeriod;
+    lastVsync = mLastHwVsync;
+    if (mSoftVsyncActive) {
+        nsecs_t lastSoftVsync = mSoftVsync->getLastVsync();
+        if (lastSoftVsync > lastVsync) {
+            lastVsync = lastSoftVsync;
+        }
+    }
+    return lastVsync != 0;
+}
+
 bool VsyncEventObserver::control(bool enabled)
 {
     ALOGTRACE("enabled = %d on device %d", enabled, mDevice);
@@ -92,6 +128,10 @@ bool VsyncEventObserver::control(bool enabled)
     }
 
     Mutex::Autolock _l(mLock);
+    if (!enabled) {
+        stopSoftVsyncLocked();
+    }
+
     bool ret = mVsyncControl->control(mDevice, enabled);
     if (!ret) {
         ELOGTRACE("failed to control (%d) vsync on display %d", enabled, mDevice);
@@ -122,10 +162,20 @@ bool VsyncEventObserver::threadLoop()
         bool ret = mVsyncControl->wait(mDevice, timestamp);
         if (ret == false) {
             WLOGTRACE("failed to wait for vsync on display %d, vsync enabled %d", mDevice, mEnabled);
+            {
+                Mutex::Autolock _l(mLock);
+                if (mEnabled) {
+                    startSoftVsyncLocked();
+                }
+            }
             usleep(16000);
             return true;
         }
 
+        if (!onHardwareVsync(timestamp)) {
+            return true;
+        }
+
         // notify device
         mDisplayDevice.onVsync(timestamp);
     }
@@ -133,5 +183,67 @@ bool VsyncEventObserver::threadLoop()
     return true;
 }
 
+bool VsyncEventObserver::onHardwareVsync(nsecs_t timestamp)
+{
+    Mutex::Autolock _l(mLock);
+
+    // update period estimate, samples not close to it are either missed
+    // vsyncs or a refresh rate change
+    if (mLastHwVsync && timestamp > mLastHwVsync) {
+        nsecs_t delta = timestamp - mLastHwVsync;
+        if (!mPeriod || mRejectedSamples >= MAX_REJECTED_SAMPLES) {
+            mPeriod = delta;
+            mRejectedSamples = 0;
+        } else if (delta > mPeriod * 3 / 4 && delta < mPeriod * 5 / 4) {
+            mPeriod += (delta - mPeriod) >> PERIOD_FILTER_SHIFT;
+            mRejectedSamples = 0;
+        } else {
+            mRejectedSamples++;
+        }
+    }
+    mLastHwVsync = timestamp;
+
+    if (!mSoftVsyncActive) {
+        return true;
+    }
+
+    // hand back to hardware vsync, drop this one if the soft vsync just
+    // reported the same refresh
+    nsecs_t lastSoftVsync = mSoftVsync->getLastVsync();
+    stopSoftVsyncLocked();
+    if (mPeriod && timestamp - lastSoftVsync < mPeriod / 2) {
+        VLOGTRACE("drop hardware vsync %lld, soft vsync %lld",
+            timestamp, lastSoftVsync);
+        return false;
+    }
+    return true;
+}
+
+void VsyncEventObserver::startSoftVsyncLocked()
+{
+    if (mSoftVsyncActive || !mSoftVsync) {
+        return;
+    }
+
+    // continue in phase with the last hardware vsync if there is one
+    if (mPeriod && mLastHwVsync) {
+        mSoftVsync->setPhase(mPeriod, mLastHwVsync);
+    }
+    DLOGTRACE("hardware vsync unavailable on display %d, use soft vsync", mDevice);
+    mSoftVsync->control(true);
+    mSoftVsyncActive = true;
+}
+
+void VsyncEventObserver::stopSoftVsyncLocked()
+{
+    if (!mSoftVsyncActive) {
+        return;
+    }
+
+    DLOGTRACE("stop soft vsync on display %d", mDevice);
+    mSoftVsync->control(false);
+    mSoftVsyncActive = false;
+}
+
 } // namespace intel
 } // namesapce android
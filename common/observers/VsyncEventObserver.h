@@ -23,6 +23,7 @@ namespace android {
 namespace intel {
 
 class PhysicalDevice;
+class SoftVsyncObserver;
 
 class VsyncEventObserver {
 public:
@@ -33,8 +34,23 @@ public:
     virtual bool initialize();
     virtual void deinitialize();
     bool control(bool enabled);
+    // measured vsync period and the latest vsync, false if unknown
+    bool getVsyncModel(nsecs_t& period, nsecs_t& lastVsync) const;
 
 private:
+    // returns false if the hardware vsync must not be reported
+    bool onHardwareVsync(nsecs_t timestamp);
+    void startSoftVsyncLocked();
+    void stopSoftVsyncLocked();
+
+private:
+    enum {
+        // weight of a new sample in the period estimate is 1/2^shift
+        PERIOD_FILTER_SHIFT = 3,
+        // re-learn the period after this many inconsistent samples
+        MAX_REJECTED_SAMPLES = 8,
+    };
+
     mutable Mutex mLock;
     Condition mCondition;
     PhysicalDevice& mDisplayDevice;
@@ -44,6 +60,14 @@ private:
     bool mExitThread;
     bool mInitialized;
 
+    // measured hardware vsync, used to keep the soft vsync in phase
+    // while hardware vsync is unavailable
+    SoftVsyncObserver *mSoftVsync;
+    bool mSoftVsyncActive;
+    nsecs_t mPeriod;
+    nsecs_t mLastHwVsync;
+    int mRejectedSamples;
+
 private:
     DECLARE_THREAD(VsyncEventPollThread, VsyncEventObserver);
 };
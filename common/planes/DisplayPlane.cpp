@@ -14,6 +14,7 @@
 // limitations under the License.
 */
 #include <common/utils/HwcTrace.h>
+#include <common/utils/HwcMetrics.h>
 #include <Hwcomposer.h>
 #include <DisplayPlane.h>
 #include <GraphicBuffer.h>
@@ -248,10 +249,13 @@ bool DisplayPlane::setDataBuffer(uint32_t handle)
 BufferMapper* DisplayPlane::mapBuffer(DataBuffer *buffer)
 {
     BufferManager *bm = Hwcomposer::getInstance().getBufferManager();
+    PhaseTimer timer(HwcMetrics::PHASE_BUFFER_MAPPING);
+    HwcMetrics::increase(HwcMetrics::COUNTER_BUFFER_MAPS);
 
     // invalidate buffer cache  if cache is full
+    // planes may keep other caches, only flush the gralloc buffers here
     if ((int)mDataBuffers.size() >= mCacheCapacity) {
-        invalidateBufferCache();
+        DisplayPlane::invalidateBufferCache();
     }
 
     BufferMapper *mapper = bm->map(*buffer);
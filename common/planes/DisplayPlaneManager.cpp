@@ -342,6 +342,15 @@ void DisplayPlaneManager::dump(Dump& d)
              mPlaneCount[DisplayPlane::PLANE_CURSOR],
              mFreePlanes[DisplayPlane::PLANE_CURSOR],
              mReclaimedPlanes[DisplayPlane::PLANE_CURSOR]);
+
+    for (int i = 0; i < DisplayPlane::PLANE_MAX; i++) {
+        for (size_t j = 0; j < mPlanes[i].size(); j++) {
+            DisplayPlane *plane = mPlanes[i].itemAt(j);
+            if (plane) {
+                plane->dump(d);
+            }
+        }
+    }
 }
 
 } // namespace intel
@@ -0,0 +1,190 @@
+/*
+// Copyright (c) 2014 Intel Corporation 
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#include <common/utils/HwcTrace.h>
+#include <IDisplayDevice.h>
+#include <common/planes/DummyPlaneManager.h>
+
+namespace android {
+namespace intel {
+
+DummyPlane::DummyPlane(int index, int type, int disp)
+    : DisplayPlane(index, type, disp)
+{
+    CTRACE();
+}
+
+DummyPlane::~DummyPlane()
+{
+    CTRACE();
+}
+
+bool DummyPlane::setDataBuffer(uint32_t handle)
+{
+    RETURN_FALSE_IF_NOT_INIT();
+
+    // nothing is scanned out, the buffer is never mapped
+    if (!handle) {
+        return false;
+    }
+    if (mCurrentDataBuffer != handle) {
+        mUpdateMasks |= PLANE_BUFFER_CHANGED;
+        mCurrentDataBuffer = handle;
+    }
+    return true;
+}
+
+bool DummyPlane::setDataBuffer(BufferMapper& /* mapper */)
+{
+    return true;
+}
+
+bool DummyPlane::assignToDevice(int disp)
+{
+    RETURN_FALSE_IF_NOT_INIT();
+
+    mDevice = disp;
+    return true;
+}
+
+bool DummyPlane::enable()
+{
+    return true;
+}
+
+bool DummyPlane::disable()
+{
+    return true;
+}
+
+bool DummyPlane::isDisabled()
+{
+    return true;
+}
+
+void DummyPlane::setZOrderConfig(ZOrderConfig& /* config */,
+                                     void * /* nativeConfig */)
+{
+}
+
+void* DummyPlane::getContext() const
+{
+    return NULL;
+}
+
+DummyPlaneManager::DummyPlaneManager(int spritePlanes, int overlayPlanes)
+    : DisplayPlaneManager()
+{
+    mSpritePlaneCount = spritePlanes;
+    mOverlayPlaneCount = overlayPlanes;
+    mCursorPlaneCount = 0;
+}
+
+DummyPlaneManager::~DummyPlaneManager()
+{
+}
+
+bool DummyPlaneManager::initialize()
+{
+    // one primary plane per pipe, taken by the frame buffer target
+    mPrimaryPlaneCount = DEFAULT_PRIMARY_PLANE_COUNT;
+
+    return DisplayPlaneManager::initialize();
+}
+
+void DummyPlaneManager::deinitialize()
+{
+    DisplayPlaneManager::deinitialize();
+}
+
+DisplayPlane* DummyPlaneManager::allocPlane(int index, int type)
+{
+    DisplayPlane *plane = NULL;
+
+    switch (type) {
+    case DisplayPlane::PLANE_PRIMARY:
+        plane = new DummyPlane(index, type, index/*disp*/);
+        break;
+    case DisplayPlane::PLANE_SPRITE:
+    case DisplayPlane::PLANE_OVERLAY:
+        plane = new DummyPlane(index, type, 0/*disp*/);
+        break;
+    default:
+        ELOGTRACE("unsupported type %d", type);
+        break;
+    }
+
+    if (plane && !plane->initialize(DisplayPlane::MIN_DATA_BUFFER_COUNT)) {
+        ELOGTRACE("failed to initialize plane.");
+        DEINIT_AND_DELETE_OBJ(plane);
+    }
+
+    return plane;
+}
+
+bool DummyPlaneManager::isValidZOrder(int dsp, ZOrderConfig& config)
+{
+    if (dsp < 0 || dsp > IDisplayDevice::DEVICE_EXTERNAL) {
+        ELOGTRACE("invalid display device %d", dsp);
+        return false;
+    }
+
+    // any order works, only the number of planes is limited
+    int count[DisplayPlane::PLANE_MAX] = { 0 };
+    for (size_t i = 0; i < config.size(); i++) {
+        int type = config[i]->planeType;
+        if (type < 0 || type >= DisplayPlane::PLANE_MAX) {
+            return false;
+        }
+        if (++count[type] > getFreePlanes(dsp, type)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool DummyPlaneManager::assignPlanes(int dsp, ZOrderConfig& config)
+{
+    if (!isValidZOrder(dsp, config)) {
+        return false;
+    }
+
+    for (size_t i = 0; i < config.size(); i++) {
+        ZOrderLayer *zlayer = config.itemAt(i);
+        if (zlayer->planeType == DisplayPlane::PLANE_PRIMARY) {
+            zlayer->plane = getPlane(zlayer->planeType, dsp);
+        } else {
+            zlayer->plane = getAnyPlane(zlayer->planeType);
+        }
+        if (!zlayer->plane) {
+            ELOGTRACE("no free plane of type %d", zlayer->planeType);
+            // return the planes taken so far
+            for (size_t j = 0; j < i; j++) {
+                putPlane(dsp, *config.itemAt(j)->plane);
+                config.itemAt(j)->plane = NULL;
+            }
+            return false;
+        }
+    }
+    return true;
+}
+
+void* DummyPlaneManager::getZOrderConfig() const
+{
+    return NULL;
+}
+
+} // namespace intel
+} // namespace android
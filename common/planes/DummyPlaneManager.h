@@ -0,0 +1,67 @@
+/*
+// Copyright (c) 2014 Intel Corporation 
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#ifndef DUMMY_PLANE_MANAGER_H
+#define DUMMY_PLANE_MANAGER_H
+
+#include <DisplayPlane.h>
+#include <DisplayPlaneManager.h>
+
+namespace android {
+namespace intel {
+
+// plane that takes layers without touching the display hardware or
+// mapping their buffers
+class DummyPlane : public DisplayPlane {
+public:
+    DummyPlane(int index, int type, int disp);
+    virtual ~DummyPlane();
+
+public:
+    virtual bool setDataBuffer(uint32_t handle);
+    virtual bool assignToDevice(int disp);
+    virtual bool enable();
+    virtual bool disable();
+    virtual bool isDisabled();
+    virtual void setZOrderConfig(ZOrderConfig& config, void *nativeConfig);
+    virtual void* getContext() const;
+
+protected:
+    virtual bool setDataBuffer(BufferMapper& mapper);
+};
+
+// private plane pool of a headless display, so its layer list never
+// takes planes from the physical displays
+class DummyPlaneManager : public DisplayPlaneManager {
+public:
+    DummyPlaneManager(int spritePlanes, int overlayPlanes);
+    virtual ~DummyPlaneManager();
+
+public:
+    virtual bool initialize();
+    virtual void deinitialize();
+    virtual bool isValidZOrder(int dsp, ZOrderConfig& config);
+    virtual bool assignPlanes(int dsp, ZOrderConfig& config);
+    // TODO: remove this API
+    virtual void* getZOrderConfig() const;
+
+protected:
+    DisplayPlane* allocPlane(int index, int type);
+};
+
+} // namespace intel
+} // namespace android
+
+#endif /* DUMMY_PLANE_MANAGER_H */
@@ -0,0 +1,75 @@
+/*
+// Copyright (c) 2014 Intel Corporation 
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#ifndef FRAME_TRACE_FORMAT_H
+#define FRAME_TRACE_FORMAT_H
+
+#include <stdint.h>
+
+/*
+ * On-disk layout of a frame trace, shared with the host side tool so it
+ * must not depend on any Android header.
+ *
+ * frame_trace_header
+ * frame_count x {
+ *     frame_trace_frame
+ *     num_displays x {
+ *         frame_trace_display
+ *         num_layers x frame_trace_layer
+ *     }
+ * }
+ */
+
+#define FRAME_TRACE_MAGIC       0x54435748  /* "HWCT" */
+#define FRAME_TRACE_VERSION     1
+
+struct frame_trace_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t frame_count;
+    uint32_t layer_size;
+} __attribute__((packed));
+
+struct frame_trace_frame {
+    int64_t timestamp;           /* prepare start, monotonic ns */
+    int64_t prepare_duration;    /* ns */
+    int64_t commit_duration;     /* ns, 0 if the frame wasn't committed */
+    uint32_t num_displays;
+} __attribute__((packed));
+
+struct frame_trace_display {
+    uint32_t flags;
+    uint32_t num_layers;         /* layers recorded, may be truncated */
+    uint32_t num_hw_layers;      /* layers in the original list */
+} __attribute__((packed));
+
+struct frame_trace_layer {
+    uint64_t buffer;             /* gralloc stamp, 0 if no buffer */
+    uint32_t handle;
+    uint32_t composition_type;
+    uint32_t hints;
+    uint32_t flags;
+    uint32_t transform;
+    uint32_t blending;
+    int32_t format;
+    int32_t width;
+    int32_t height;
+    float source_crop[4];        /* left, top, right, bottom */
+    int32_t display_frame[4];    /* left, top, right, bottom */
+    uint8_t plane_alpha;
+    uint8_t reserved[3];
+} __attribute__((packed));
+
+#endif /* FRAME_TRACE_FORMAT_H */
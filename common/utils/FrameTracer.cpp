@@ -0,0 +1,231 @@
+/*
+// Copyright (c) 2014 Intel Corporation 
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cutils/properties.h>
+#include <common/utils/HwcTrace.h>
+#include <common/utils/FrameTracer.h>
+#include <Hwcomposer.h>
+
+namespace android {
+namespace intel {
+
+static const char *DEFAULT_TRACE_PATH = "/data/local/tmp/hwc_frames.trace";
+
+FrameTracer::FrameTracer()
+    : mEntries(NULL),
+      mHead(0),
+      mCount(0),
+      mEnabled(false),
+      mInitialized(false)
+{
+    CTRACE();
+}
+
+FrameTracer::~FrameTracer()
+{
+    WARN_IF_NOT_DEINIT();
+}
+
+bool FrameTracer::initialize()
+{
+    char prop[PROPERTY_VALUE_MAX];
+
+    mEnabled = false;
+    if (property_get("debug.hwc.trace.enable", prop, "0") > 0 && atoi(prop)) {
+        // ring is only allocated when tracing is on
+        mEntries = new TraceEntry[TRACE_FRAME_COUNT];
+        if (!mEntries) {
+            ELOGTRACE("failed to allocate trace ring");
+            return false;
+        }
+        mEnabled = true;
+        ILOGTRACE("frame tracing enabled, %d frames", TRACE_FRAME_COUNT);
+    }
+
+    mHead = 0;
+    mCount = 0;
+    mInitialized = true;
+    return true;
+}
+
+void FrameTracer::deinitialize()
+{
+    Mutex::Autolock _l(mLock);
+
+    delete [] mEntries;
+    mEntries = NULL;
+    mEnabled = false;
+    mInitialized = false;
+}
+
+void FrameTracer::recordLayer(frame_trace_layer& dst, hwc_layer_1_t& src)
+{
+    memset(&dst, 0, sizeof(dst));
+
+    dst.handle = (uint32_t)src.handle;
+    dst.composition_type = src.compositionType;
+    dst.hints = src.hints;
+    dst.flags = src.flags;
+    dst.transform = src.transform;
+    dst.blending = src.blending;
+    dst.source_crop[0] = src.sourceCropf.left;
+    dst.source_crop[1] = src.sourceCropf.top;
+    dst.source_crop[2] = src.sourceCropf.right;
+    dst.source_crop[3] = src.sourceCropf.bottom;
+    dst.display_frame[0] = src.displayFrame.left;
+    dst.display_frame[1] = src.displayFrame.top;
+    dst.display_frame[2] = src.displayFrame.right;
+    dst.display_frame[3] = src.displayFrame.bottom;
+    dst.plane_alpha = src.planeAlpha;
+
+    if (!src.handle) {
+        return;
+    }
+
+    BufferManager *bm = Hwcomposer::getInstance().getBufferManager();
+    DataBuffer *buffer = bm->lockDataBuffer((uint32_t)src.handle);
+    if (!buffer) {
+        return;
+    }
+    dst.buffer = buffer->getKey();
+    dst.format = buffer->getFormat();
+    dst.width = buffer->getWidth();
+    dst.height = buffer->getHeight();
+    bm->unlockDataBuffer(buffer);
+}
+
+void FrameTracer::recordPrepare(size_t numDisplays,
+                                hwc_display_contents_1_t **displays,
+                                nsecs_t start)
+{
+    if (!mEnabled) {
+        return;
+    }
+
+    Mutex::Autolock _l(mLock);
+
+    TraceEntry& entry = mEntries[mHead];
+    entry.frame.timestamp = start;
+    entry.frame.prepare_duration = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+    entry.frame.commit_duration = 0;
+    entry.frame.num_displays = numDisplays;
+    if (numDisplays > TRACE_DISPLAY_COUNT) {
+        entry.frame.num_displays = TRACE_DISPLAY_COUNT;
+    }
+
+    for (size_t i = 0; i < entry.frame.num_displays; i++) {
+        frame_trace_display& display = entry.displays[i];
+        hwc_display_contents_1_t *list = displays[i];
+        if (!list) {
+            memset(&display, 0, sizeof(display));
+            continue;
+        }
+
+        display.flags = list->flags;
+        display.num_hw_layers = list->numHwLayers;
+        display.num_layers = list->numHwLayers;
+        if (display.num_layers > TRACE_LAYER_COUNT) {
+            display.num_layers = TRACE_LAYER_COUNT;
+        }
+        for (size_t j = 0; j < display.num_layers; j++) {
+            recordLayer(entry.layers[i][j], list->hwLayers[j]);
+        }
+    }
+
+    mHead = (mHead + 1) % TRACE_FRAME_COUNT;
+    if (mCount < TRACE_FRAME_COUNT) {
+        mCount++;
+    }
+}
+
+void FrameTracer::recordCommit(nsecs_t start)
+{
+    if (!mEnabled) {
+        return;
+    }
+
+    Mutex::Autolock _l(mLock);
+
+    if (!mCount) {
+        return;
+    }
+
+    // commit always follows the prepare of the same frame
+    size_t last = (mHead + TRACE_FRAME_COUNT - 1) % TRACE_FRAME_COUNT;
+    mEntries[last].frame.commit_duration = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+}
+
+bool FrameTracer::save(const char *path)
+{
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        ELOGTRACE("failed to open %s", path);
+        return false;
+    }
+
+    frame_trace_header header;
+    header.magic = FRAME_TRACE_MAGIC;
+    header.version = FRAME_TRACE_VERSION;
+    header.frame_count = mCount;
+    header.layer_size = sizeof(frame_trace_layer);
+
+    bool ret = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    // oldest frame first
+    size_t first = (mHead + TRACE_FRAME_COUNT - mCount) % TRACE_FRAME_COUNT;
+    for (size_t i = 0; ret && i < mCount; i++) {
+        const TraceEntry& entry = mEntries[(first + i) % TRACE_FRAME_COUNT];
+        ret = fwrite(&entry.frame, sizeof(entry.frame), 1, file) == 1;
+        for (size_t j = 0; ret && j < entry.frame.num_displays; j++) {
+            const frame_trace_display& display = entry.displays[j];
+            ret = fwrite(&display, sizeof(display), 1, file) == 1;
+            if (ret && display.num_layers) {
+                ret = fwrite(entry.layers[j], sizeof(frame_trace_layer),
+                             display.num_layers, file) == display.num_layers;
+            }
+        }
+    }
+
+    fclose(file);
+    if (!ret) {
+        ELOGTRACE("failed to write %s", path);
+    }
+    return ret;
+}
+
+void FrameTracer::dump(Dump& d)
+{
+    if (!mEnabled) {
+        return;
+    }
+
+    Mutex::Autolock _l(mLock);
+
+    char path[PROPERTY_VALUE_MAX];
+    property_get("debug.hwc.trace.path", path, DEFAULT_TRACE_PATH);
+
+    d.append("-------------------------------------------------------------\n");
+    if (save(path)) {
+        d.append("Frame trace: %d frames saved to %s\n", mCount, path);
+    } else {
+        d.append("Frame trace: failed to save to %s\n", path);
+    }
+}
+
+} // namespace intel
+} // namespace android
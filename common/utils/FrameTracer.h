@@ -0,0 +1,74 @@
+/*
+// Copyright (c) 2014 Intel Corporation 
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#ifndef FRAME_TRACER_H
+#define FRAME_TRACER_H
+
+#include <hardware/hwcomposer.h>
+#include <utils/threads.h>
+#include <utils/Timers.h>
+#include <common/utils/Dump.h>
+#include <common/utils/FrameTraceFormat.h>
+
+namespace android {
+namespace intel {
+
+// Records the display contents handed to prepare/set into a ring buffer.
+// Enabled with debug.hwc.trace.enable, the ring is written to disk on
+// every hwc dump so it can be inspected offline.
+class FrameTracer {
+public:
+    FrameTracer();
+    ~FrameTracer();
+public:
+    bool initialize();
+    void deinitialize();
+    bool isEnabled() const { return mEnabled; }
+    void recordPrepare(size_t numDisplays,
+                       hwc_display_contents_1_t **displays,
+                       nsecs_t start);
+    void recordCommit(nsecs_t start);
+    void dump(Dump& d);
+
+private:
+    enum {
+        TRACE_FRAME_COUNT = 256,
+        TRACE_DISPLAY_COUNT = 3,
+        TRACE_LAYER_COUNT = 16,
+    };
+
+    struct TraceEntry {
+        frame_trace_frame frame;
+        frame_trace_display displays[TRACE_DISPLAY_COUNT];
+        frame_trace_layer layers[TRACE_DISPLAY_COUNT][TRACE_LAYER_COUNT];
+    };
+
+    void recordLayer(frame_trace_layer& dst, hwc_layer_1_t& src);
+    bool save(const char *path);
+
+private:
+    TraceEntry *mEntries;
+    // index of the next entry to write
+    size_t mHead;
+    size_t mCount;
+    bool mEnabled;
+    Mutex mLock;
+    bool mInitialized;
+};
+
+} // namespace intel
+} // namespace android
+
+#endif /* FRAME_TRACER_H */
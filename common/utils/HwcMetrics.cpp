@@ -0,0 +1,175 @@
+/*
+// Copyright (c) 2014 Intel Corporation 
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <cutils/properties.h>
+#include <common/utils/HwcTrace.h>
+#include <common/utils/HwcMetrics.h>
+
+namespace android {
+namespace intel {
+
+HwcMetrics::Histogram HwcMetrics::sHistograms[HwcMetrics::PHASE_COUNT];
+volatile int64_t HwcMetrics::sCounters[HwcMetrics::COUNTER_COUNT];
+volatile nsecs_t HwcMetrics::sResetTime(0);
+
+static const char* sPhaseNames[HwcMetrics::PHASE_COUNT] = {
+    "prepare",
+    "plane alloc",
+    "buffer map",
+    "commit",
+    "IMG post",
+    "fence",
+    "mode set",
+    "plug to frame",
+};
+
+static const char* sCounterNames[HwcMetrics::COUNTER_COUNT] = {
+    "frames",
+    "geometry changes",
+    "buffer maps",
+    "post failures",
+};
+
+int HwcMetrics::getBucket(int64_t us)
+{
+    if (us < 2) {
+        return 0;
+    }
+
+    int bucket = 63 - __builtin_clzll((uint64_t)us);
+    if (bucket >= BUCKET_COUNT) {
+        bucket = BUCKET_COUNT - 1;
+    }
+    return bucket;
+}
+
+void HwcMetrics::record(int phase, nsecs_t duration)
+{
+    if (phase < 0 || phase >= PHASE_COUNT) {
+        return;
+    }
+
+    Histogram& h = sHistograms[phase];
+    int64_t us = duration / 1000;
+
+    __sync_fetch_and_add(&h.buckets[getBucket(us)], 1);
+    __sync_fetch_and_add(&h.count, 1);
+    __sync_fetch_and_add(&h.total, us);
+
+    int64_t max = h.max;
+    while (us > max) {
+        if (__sync_bool_compare_and_swap(&h.max, max, us)) {
+            break;
+        }
+        max = h.max;
+    }
+}
+
+void HwcMetrics::increase(int counter)
+{
+    if (counter < 0 || counter >= COUNTER_COUNT) {
+        return;
+    }
+
+    __sync_fetch_and_add(&sCounters[counter], 1);
+}
+
+void HwcMetrics::reset()
+{
+    // writers are not stopped, a sample racing with reset may be lost
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        memset((void *)&sHistograms[i], 0, sizeof(Histogram));
+    }
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        sCounters[i] = 0;
+    }
+    __sync_synchronize();
+    sResetTime = systemTime(SYSTEM_TIME_MONOTONIC);
+}
+
+int64_t HwcMetrics::getPercentile(const Histogram& h, int64_t count, int percent)
+{
+    int64_t target = (count * percent + 99) / 100;
+    int64_t sum = 0;
+
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        sum += h.buckets[i];
+        if (sum >= target) {
+            // report the upper bound of the bucket
+            return (i == BUCKET_COUNT - 1) ? h.max : (2LL << i);
+        }
+    }
+    return h.max;
+}
+
+void HwcMetrics::dump(Dump& d)
+{
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    d.append("-------------------------------------------------------------\n");
+    d.append("Frame metrics (last %lld ms):\n", (now - sResetTime) / 1000000);
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        d.append("  %-17s: %lld\n", sCounterNames[i], sCounters[i]);
+    }
+
+    d.append("  PHASE       | COUNT  | AVG(us) | P50(us) | P99(us) | MAX(us) \n");
+    d.append("--------------+--------+---------+---------+---------+---------\n");
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        const Histogram& h = sHistograms[i];
+        int64_t count = h.count;
+        if (!count) {
+            d.append("  %-11s | %6d |       - |       - |       - |       - \n",
+                     sPhaseNames[i], 0);
+            continue;
+        }
+        d.append("  %-11s | %6lld | %7lld | %7lld | %7lld | %7lld \n",
+                 sPhaseNames[i],
+                 count,
+                 h.total / count,
+                 getPercentile(h, count, 50),
+                 getPercentile(h, count, 99),
+                 h.max);
+    }
+
+    d.append("Latency buckets (us, upper bound):\n");
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        const Histogram& h = sHistograms[i];
+        if (!h.count) {
+            continue;
+        }
+        d.append("  %-11s:", sPhaseNames[i]);
+        for (int j = 0; j < BUCKET_COUNT; j++) {
+            if (h.buckets[j]) {
+                if (j == BUCKET_COUNT - 1) {
+                    d.append(" >%d:%d", 1 << j, h.buckets[j]);
+                } else {
+                    d.append(" %d:%d", 2 << j, h.buckets[j]);
+                }
+            }
+        }
+        d.append("\n");
+    }
+
+    // when set, every dump reports the interval since the previous one
+    char prop[PROPERTY_VALUE_MAX];
+    if (property_get("debug.hwc.metrics.reset", prop, "0") > 0 && atoi(prop)) {
+        reset();
+    }
+}
+
+} // namespace intel
+} // namespace android
@@ -0,0 +1,99 @@
+/*
+// Copyright (c) 2014 Intel Corporation 
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#ifndef HWC_METRICS_H
+#define HWC_METRICS_H
+
+#include <stdint.h>
+#include <utils/Timers.h>
+#include <common/utils/Dump.h>
+
+namespace android {
+namespace intel {
+
+// Always-on frame metrics. Writers only do atomic adds so it is cheap
+// enough to stay enabled in shipping builds.
+class HwcMetrics {
+public:
+    enum {
+        PHASE_PREPARE = 0,
+        PHASE_PLANE_ALLOCATION,
+        PHASE_BUFFER_MAPPING,
+        PHASE_COMMIT,
+        PHASE_IMG_POST,
+        PHASE_FENCE,
+        // external display, from mode setting start to the mode being set
+        PHASE_MODE_SET,
+        // external display, from plug or mode change to its first commit
+        PHASE_PLUG_TO_FRAME,
+        PHASE_COUNT,
+    };
+
+    enum {
+        COUNTER_FRAMES = 0,
+        COUNTER_GEOMETRY_CHANGES,
+        COUNTER_BUFFER_MAPS,
+        COUNTER_POST_FAILURES,
+        COUNTER_COUNT,
+    };
+
+    enum {
+        // bucket 0 holds samples below 2us, bucket i holds [2^i, 2^(i+1)) us
+        // and the last bucket is open ended
+        BUCKET_COUNT = 16,
+    };
+
+public:
+    static void record(int phase, nsecs_t duration);
+    static void increase(int counter);
+    static void reset();
+    static void dump(Dump& d);
+
+private:
+    struct Histogram {
+        volatile int32_t buckets[BUCKET_COUNT];
+        volatile int64_t count;
+        volatile int64_t total;
+        volatile int64_t max;
+    };
+
+    static int getBucket(int64_t us);
+    static int64_t getPercentile(const Histogram& h, int64_t count, int percent);
+
+private:
+    static Histogram sHistograms[PHASE_COUNT];
+    static volatile int64_t sCounters[COUNTER_COUNT];
+    static volatile nsecs_t sResetTime;
+};
+
+// records its own lifetime into a phase histogram
+class PhaseTimer {
+public:
+    PhaseTimer(int phase)
+        : mPhase(phase),
+          mStart(systemTime(SYSTEM_TIME_MONOTONIC))
+    {}
+    ~PhaseTimer() {
+        HwcMetrics::record(mPhase, systemTime(SYSTEM_TIME_MONOTONIC) - mStart);
+    }
+private:
+    int mPhase;
+    nsecs_t mStart;
+};
+
+} // namespace intel
+} // namespace android
+
+#endif /* HWC_METRICS_H */
@@ -21,6 +21,9 @@
 #include <BufferMapper.h>
 #include <common/buffers/BufferCache.h>
 #include <utils/Mutex.h>
+#include <utils/Condition.h>
+#include <utils/Vector.h>
+#include <common/base/SimpleThread.h>
 
 namespace android {
 namespace intel {
@@ -36,12 +39,12 @@ public:
     virtual void deinitialize();
 
     // dump interface
-    void dump(Dump& d);
+    virtual void dump(Dump& d);
 
     // lockDataBuffer and unlockDataBuffer must be used in serial
     // nested calling of them will cause a deadlock
-    DataBuffer* lockDataBuffer(uint32_t handle);
-    void unlockDataBuffer(DataBuffer *buffer);
+    virtual DataBuffer* lockDataBuffer(uint32_t handle);
+    virtual void unlockDataBuffer(DataBuffer *buffer);
 
     // get and put interfaces are deprecated
     // use lockDataBuffer and unlockDataBuffer instead
@@ -52,6 +55,12 @@ public:
     BufferMapper* map(DataBuffer& buffer);
     void unmap(BufferMapper *mapper);
 
+    // map a buffer on the map-ahead thread before it reaches a plane,
+    // map() then picks up the ready mapper
+    void mapAhead(uint32_t handle);
+    // called once per frame, drops map-ahead work that went unused
+    void expireMapAhead();
+
     // frame buffer management
     //return 0 if allocation fails
     virtual uint32_t allocFrameBuffer(int width, int height, int *stride);
@@ -72,8 +81,33 @@ private:
     enum {
         // make the buffer pool large enough
         DEFAULT_BUFFER_POOL_SIZE = 128,
+        MAP_AHEAD_QUEUE_SIZE = 8,
+        MAP_AHEAD_READY_COUNT = 16,
+        // frames a mapped ahead buffer is kept without being used
+        MAP_AHEAD_EXPIRE_FRAMES = 2,
+    };
+
+    struct MapAheadStats {
+        uint32_t queued;
+        uint32_t hits;
+        uint32_t waits;
+        uint32_t steals;
+        uint32_t dropped;
+        uint32_t evictions;
+        uint32_t expirations;
+        uint32_t failures;
     };
 
+    struct MapAheadEntry {
+        BufferMapper *mapper;
+        uint32_t frame;
+    };
+
+    bool startMapAhead();
+    void stopMapAhead();
+    BufferMapper* takeMapAheadMapper(uint64_t key);
+    bool isMapAheadPending(uint32_t handle);
+
     alloc_device_t *mAllocDev;
     KeyedVector<uint32_t, BufferMapper*> mFrameBuffers;
     BufferCache *mBufferPool;
@@ -81,6 +115,20 @@ private:
     Mutex mDataBufferLock;
     Mutex mLock;
     bool mInitialized;
+
+    // map-ahead state, protected by mLock. Only handles are queued, the
+    // worker creates and maps their mappers
+    Vector<uint32_t> mMapAheadQueue;
+    Vector<MapAheadEntry> mMapAheadReady;
+    // unused mappers for the worker to unmap
+    Vector<BufferMapper*> mMapAheadExpired;
+    uint32_t mMapAheadCurrent;
+    uint32_t mMapAheadFrame;
+    Condition mMapAheadCond;
+    Condition mMapAheadDoneCond;
+    bool mMapAheadExiting;
+    MapAheadStats mMapAheadStats;
+    DECLARE_THREAD(MapAheadThread, BufferManager);
 };
 
 } // namespace intel
@@ -89,6 +89,7 @@ private:
         mWidth = 0;
         mHeight = 0;
         mKey = handle;
+        mIsCompression = false;
         memset(&mStride, 0, sizeof(stride_t));
         memset(&mCrop, 0, sizeof(crop_t));
     }
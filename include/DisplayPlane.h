@@ -19,6 +19,7 @@
 #include <utils/KeyedVector.h>
 #include <BufferMapper.h>
 #include <common/base/Drm.h>
+#include <common/utils/Dump.h>
 
 namespace android {
 namespace intel {
@@ -110,10 +111,16 @@ public:
     virtual int getZOrder() const;
 
     virtual void* getContext() const = 0;
+    // fence to merge into the release fence of the layer flipped last,
+    // -1 if none. The caller owns the returned fd
+    virtual int getReleaseFence() { return -1; }
 
     virtual bool initialize(uint32_t bufferCount);
     virtual void deinitialize();
 
+    // dump interface
+    virtual void dump(Dump& /* d */) {}
+
 protected:
     virtual void checkPosition(int& x, int& y, int& w, int& h);
     virtual bool setDataBuffer(BufferMapper& mapper) = 0;
@@ -16,6 +16,8 @@
 #ifndef DUMMY_DEVICE_H
 #define DUMMY_DEVICE_H
 
+#include <utils/threads.h>
+#include <common/base/SimpleThread.h>
 #include <IDisplayDevice.h>
 
 namespace android {
@@ -23,6 +25,8 @@ namespace intel {
 
 class Hwcomposer;
 class SoftVsyncObserver;
+class HwcLayerList;
+class DummyPlaneManager;
 
 class DummyDevice : public IDisplayDevice {
 public:
@@ -57,15 +61,56 @@ public:
     virtual void onVsync(int64_t timestamp);
     virtual void dump(Dump& d);
 
+    // debug.hwc.dummy.connected is set, the dummy display in a physical
+    // display slot is then exposed as a headless display
+    static bool isHeadlessEnabled();
+
+protected:
+    virtual void loadConfig();
+    // runs layer lists against the private planes
+    bool isHeadless() const;
+
 protected:
+    // default headless configuration, planes as on a real pipe
+    enum {
+        DEFAULT_WIDTH = 1280,
+        DEFAULT_HEIGHT = 720,
+        DEFAULT_REFRESH_RATE = 60,
+        DEFAULT_SPRITE_PLANES = 3,
+        DEFAULT_OVERLAY_PLANES = 2,
+        MAX_DUMMY_PLANES = 8,
+        // SurfaceFlinger registers its callbacks after hwc is opened
+        PROCS_WAIT_MS = 100,
+    };
+
     bool mInitialized;
     bool mConnected;
     bool mBlank;
     uint32_t mType;
     Hwcomposer& mHwc;
     SoftVsyncObserver *mVsyncObserver;
+    DummyPlaneManager *mPlaneManager;
+    HwcLayerList *mLayerList;
+
+    // configuration, from debug.hwc.dummy.* properties
+    int mWidth;
+    int mHeight;
+    int mRefreshRate;
+    int mSpritePlanes;
+    int mOverlayPlanes;
+
+    // composition statistics
+    uint32_t mFrameCount;
+    uint32_t mOverlayLayerCount;
+    uint32_t mFbLayerCount;
+    nsecs_t mFirstCommitTime;
+    nsecs_t mLastCommitTime;
 
     const char *mName;
+
+private:
+    // reports the headless display once SurfaceFlinger listens
+    DECLARE_THREAD(HotplugThread, DummyDevice);
 };
 
 }
@@ -32,9 +32,16 @@ public:
 public:
     virtual bool initialize();
     virtual void deinitialize();
+    virtual bool prePrepare(hwc_display_contents_1_t *display);
+    virtual bool commit(hwc_display_contents_1_t *display,
+                          IDisplayContext *context);
     virtual bool blank(bool blank);
     virtual bool setDrmMode(drmModeModeInfo& value);
+    // runs on the mode setting thread only
     virtual void setRefreshRate(int hz);
+    // switches the refresh rate on the mode setting thread, safe to call
+    // from prepare
+    virtual void requestRefreshRate(int hz);
     virtual bool getDisplaySize(int *width, int *height);
     virtual bool getDisplayConfigs(uint32_t *configs,
                                        size_t *numConfigs);
@@ -43,11 +50,14 @@ public:
                                           int32_t *values);
     virtual int  getActiveConfig();
     virtual bool setActiveConfig(int index);
+    virtual void dump(Dump& d);
 
 private:
     static void HdcpLinkStatusListener(bool success, void *userData);
     void HdcpLinkStatusListener(bool success);
     void setDrmMode();
+    // called with mLock held
+    bool startModeSettingThread();
 
 protected:
     virtual IHdcpControl* createHdcpControl() = 0;
@@ -60,11 +70,34 @@ private:
     void hotplugListener();
 
 private:
-    Condition mAbortModeSettingCond;
+    enum {
+        // fallback if surface flinger doesn't acknowledge the hot unplug
+        UNPLUG_ACK_TIMEOUT_MS = 20,
+    };
+
+    // signalled when the hot unplug is acknowledged or mode setting is
+    // aborted, both protected by mLock
+    Condition mModeSettingCond;
+    bool mWaitingUnplugAck;
+    bool mUnplugAcked;
+    bool mModeSettingAborted;
+    // work waiting for the mode setting thread, protected by mLock
     drmModeModeInfo mPendingDrmMode;
+    bool mDrmModePending;
+    bool mRefreshRatePending;
+    int mPendingRefreshRate;
+    // the mode setting thread has work and will check for more before it
+    // exits, protected by mLock
+    bool mThreadRunning;
     bool mHotplugEventPending;
     int mExpectedRefreshRate;
 
+    // plug or mode change to first frame latency, written on the uevent
+    // and mode setting threads and read on commit, protected by mLock
+    nsecs_t mPlugTime;
+    nsecs_t mLastModeSetTime;
+    nsecs_t mLastPlugToFrameTime;
+
 private:
     DECLARE_THREAD(ModeSettingThread, ExternalDevice);
 };
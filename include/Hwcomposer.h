@@ -19,6 +19,8 @@
 #include <EGL/egl.h>
 #include <hardware/hwcomposer.h>
 #include <utils/Vector.h>
+#include <utils/Timers.h>
+#include <utils/threads.h>
 
 #include <IDisplayDevice.h>
 #include <BufferManager.h>
@@ -27,6 +29,8 @@
 #include <DisplayPlaneManager.h>
 #include <common/base/DisplayAnalyzer.h>
 #include <UeventObserver.h>
+#include <common/base/SimpleThread.h>
+#include <common/utils/FrameTracer.h>
 
 namespace android {
 namespace intel {
@@ -63,6 +67,9 @@ public:
     // callbacks
     virtual void vsync(int disp, int64_t timestamp);
     virtual void hotplug(int disp, bool connected);
+    // hotplug of the headless display, reported in every build as it
+    // doesn't stand for an HDMI connector
+    virtual void headlessHotplug(int disp, bool connected);
     virtual void invalidate();
 
     virtual bool initCheck() const;
@@ -77,6 +84,8 @@ public:
     DisplayAnalyzer* getDisplayAnalyzer();
     IDisplayDevice* getDisplayDevice(int disp);
     UeventObserver* getUeventObserver();
+    // waits until SurfaceFlinger registered its callbacks, false on timeout
+    bool waitForProcs(nsecs_t timeout);
 
 protected:
     Hwcomposer();
@@ -103,6 +112,27 @@ protected:
                                                  DisplayPlaneManager& dpm) = 0;
     virtual IDisplayContext* createDisplayContext() = 0;
 
+private:
+    // initialization steps, independent ones run on the init thread
+    bool initializeIndependentComponents();
+    bool initializeDrmComponents();
+    void addInitStep(const char *name, nsecs_t start);
+    void dumpInitTimeline(Dump& d);
+    void notifyHotplug(int disp, bool connected);
+
+private:
+    enum {
+        INIT_STEP_COUNT = 16,
+    };
+
+    // startup timeline entry
+    struct InitStep {
+        const char *name;
+        nsecs_t start;
+        nsecs_t end;
+        bool async;
+    };
+
 protected:
     hwc_procs_t const *mProcs;
     Drm *mDrm;
@@ -112,7 +142,19 @@ protected:
     Vector<IDisplayDevice*> mDisplayDevices;
     IDisplayContext *mDisplayContext;
     UeventObserver *mUeventObserver;
+    FrameTracer *mFrameTracer;
     bool mInitialized;
+private:
+    Mutex mProcsLock;
+    Condition mProcsCond;
+    // startup timeline
+    Mutex mInitLock;
+    Vector<InitStep> mInitTimeline;
+    nsecs_t mInitBegin;
+    nsecs_t mInitEnd;
+    bool mAsyncInitResult;
+    pid_t mInitTid;
+    DECLARE_THREAD(InitThread, Hwcomposer);
 private:
     static Hwcomposer *sInstance;
 };
@@ -16,6 +16,8 @@
 #ifndef IHDCP_CONTROL_H
 #define IHDCP_CONTROL_H
 
+#include <common/utils/Dump.h>
+
 namespace android {
 namespace intel {
 
@@ -29,6 +31,11 @@ public:
     virtual bool startHdcp() = 0;
     virtual bool startHdcpAsync(HdcpStatusCallback cb, void *userData) = 0;
     virtual bool stopHdcp() = 0;
+    // pause authentication around a mode change and pick it up again
+    // afterwards, keeping the callback and authentication state
+    virtual bool suspendHdcp() = 0;
+    virtual bool resumeHdcp() = 0;
+    virtual void dump(Dump& d) = 0;
 };
 
 } // namespace intel
@@ -53,6 +53,8 @@ public:
     virtual int  getActiveConfig();
     virtual bool setActiveConfig(int index);
 
+    bool getVsyncModel(nsecs_t& period, nsecs_t& lastVsync) const;
+
     // display config operations
     virtual void removeDisplayConfigs();
     virtual bool detectDisplayConfigs();
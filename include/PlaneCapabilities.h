@@ -25,11 +25,19 @@ class HwcLayer;
 class PlaneCapabilities
 {
 public:
+    // builds the plane type x format capability matrix, call once
+    // before any of the checks below
+    static void initialize();
+
     static bool isFormatSupported(int planeType, HwcLayer *hwcLayer);
     static bool isSizeSupported(int planeType,  HwcLayer *hwcLayer);
     static bool isBlendingSupported(int planeType, HwcLayer *hwcLayer);
     static bool isScalingSupported(int planeType, HwcLayer *hwcLayer);
     static bool isTransformSupported(int planeType,  HwcLayer *hwcLayer);
+    static bool isCompressionSupported(int planeType, HwcLayer *hwcLayer);
+    // whether the plane can scale the frame buffer target to the display
+    static bool isFbScalingSupported(int planeType, HwcLayer *hwcLayer,
+                                     uint32_t dstW, uint32_t dstH);
 };
 
 } // namespace intel
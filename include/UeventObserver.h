@@ -39,7 +39,8 @@ public:
 
 private:
     DECLARE_THREAD(UeventObserverThread, UeventObserver);
-    void onUevent();
+    void onUevent(int length);
+    static uint32_t hashString(const char *str, size_t *length);
 
 private:
     enum {
@@ -50,11 +51,16 @@ private:
     int mUeventFd;
     int mExitRDFd;
     int mExitWDFd;
+    // envelope of the only uevent source we care about
+    const char *mEnvelope;
+    size_t mEnvelopeLength;
     struct UeventListener {
+        String8 event;
         UeventListenerFunc func;
         void *data;
     };
-    KeyedVector<String8, UeventListener*> mListeners;
+    // keyed by hash of the event string
+    KeyedVector<uint32_t, UeventListener*> mListeners;
 };
 
 } // namespace intel
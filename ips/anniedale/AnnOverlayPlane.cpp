@@ -110,6 +110,9 @@ bool AnnOverlayPlane::disable()
 {
     RETURN_FALSE_IF_NOT_INIT();
 
+    // a deferred flip must not turn the overlay back on
+    cancelDeferredFlip();
+
     if (!(mContext.ctx.ov_ctx.ovadd & (0x1 << 15)))
         return true;
 
@@ -407,9 +410,13 @@ bool AnnOverlayPlane::scalingSetup(BufferMapper& mapper)
 
     if (format == HAL_PIXEL_FORMAT_BGRX_8888 ||
         format == HAL_PIXEL_FORMAT_BGRA_8888) {
-        backBuffer->YRGBSCALE = 1 << 15 | 0 << 3 || 0 << 20;
-        backBuffer->UVSCALEV = (1 << 16);
-        return true;
+        if (srcWidth == dstWidth && srcHeight == dstHeight) {
+            backBuffer->YRGBSCALE = 1 << 15 | 0 << 3 || 0 << 20;
+            backBuffer->UVSCALEV = (1 << 16);
+            return true;
+        }
+        // scaled frame buffer target, there are no chroma planes
+        uvratio = 1;
     }
 
     if (mBobDeinterlace && !mTransform)
@@ -611,19 +618,10 @@ bool AnnOverlayPlane::isSettingRotBitAllowed()
     return true;
 }
 
-bool AnnOverlayPlane::flip(void *ctx)
+uint32_t AnnOverlayPlane::getOverlayAddress(int buf)
 {
-    uint32_t ovadd = 0;
-
-    RETURN_FALSE_IF_NOT_INIT();
-
-    if (!DisplayPlane::flip(ctx)) {
-        ELOGTRACE("failed to flip display plane.");
-        return false;
-    }
-
-    // update back buffer address
-    ovadd = (mBackBuffer[mCurrent]->gttOffsetInPage << 12);
+    // back buffer address
+    uint32_t ovadd = (mBackBuffer[buf]->gttOffsetInPage << 12);
 
     // enable rotation mode and setup rotation config
     if (mIndex == 0 && mRotationConfig != 0) {
@@ -635,17 +633,42 @@ bool AnnOverlayPlane::flip(void *ctx)
     // setup z-order config
     ovadd |= mZOrderConfig;
 
-    // load coefficients
-    ovadd |= 0x1;
-
     // enable overlay
     ovadd |= (1 << 15);
 
+    ovadd |= mPipeConfig;
+    return ovadd;
+}
+
+bool AnnOverlayPlane::flip(void *ctx)
+{
+    uint32_t ovadd = 0;
+    int displayed;
+
+    RETURN_FALSE_IF_NOT_INIT();
+
+    if (!DisplayPlane::flip(ctx)) {
+        ELOGTRACE("failed to flip display plane.");
+        return false;
+    }
+
+    // update back buffer address
+    ovadd = getOverlayAddress(mCurrent);
+
+    // load coefficients only when the scaling changed
+    if (isCoeffLoadNeeded())
+        ovadd |= 0x1;
+
+    // a new video frame early for its vsync is flipped later by the
+    // deferred flip thread, this commit keeps the displayed one
+    if (deferFlip(ovadd, displayed)) {
+        ovadd = getOverlayAddress(displayed);
+    }
+
     mContext.type = DC_OVERLAY_PLANE;
     mContext.ctx.ov_ctx.ovadd = ovadd;
     mContext.ctx.ov_ctx.index = mIndex;
     mContext.ctx.ov_ctx.pipe = mDevice;
-    mContext.ctx.ov_ctx.ovadd |= mPipeConfig;
 
     // move to next back buffer
     mCurrent = (mCurrent + 1) % OVERLAY_BACK_BUFFER_COUNT;
@@ -664,31 +687,35 @@ void* AnnOverlayPlane::getContext() const
     return (void *)&mContext;
 }
 
-bool AnnOverlayPlane::setDataBuffer(BufferMapper& mapper)
+void AnnOverlayPlane::checkDownscale(BufferMapper& mapper)
 {
-    if (mIsProtectedBuffer) {
-        // workaround overlay scaling limitation
-        float scaleX = (float)mSrcCrop.w/mPosition.w;
-        float scaleY = (float)mSrcCrop.h/mPosition.h;
-        if (scaleX > 4.0) {
-            int crop = (mSrcCrop.w - 4 * mPosition.w)/2 + 1;
-            mSrcCrop.x += crop;
-            mSrcCrop.w -= 2 * crop;
-        }
+    if (!mIsProtectedBuffer) {
+        return;
+    }
 
-        if (scaleY > 4.0) {
-            int crop = (mSrcCrop.h - 4 * mPosition.h)/2 + 1;
-            mSrcCrop.y += crop;
-            mSrcCrop.h -= 2 * crop;
-        }
+    // workaround overlay scaling limitation
+    float scaleX = (float)mSrcCrop.w/mPosition.w;
+    float scaleY = (float)mSrcCrop.h/mPosition.h;
+    if (scaleX > 4.0) {
+        int crop = (mSrcCrop.w - 4 * mPosition.w)/2 + 1;
+        mSrcCrop.x += crop;
+        mSrcCrop.w -= 2 * crop;
+    }
 
-        if (scaleX > 4.0 || scaleY > 4.0) {
-            mUpdateMasks |= PLANE_SOURCE_CROP_CHANGED;
-            mapper.setCrop(mSrcCrop.x, mSrcCrop.y, mSrcCrop.w, mSrcCrop.h);
-        }
+    if (scaleY > 4.0) {
+        int crop = (mSrcCrop.h - 4 * mPosition.h)/2 + 1;
+        mSrcCrop.y += crop;
+        mSrcCrop.h -= 2 * crop;
     }
 
+    if (scaleX > 4.0 || scaleY > 4.0) {
+        mUpdateMasks |= PLANE_SOURCE_CROP_CHANGED;
+        mapper.setCrop(mSrcCrop.x, mSrcCrop.y, mSrcCrop.w, mSrcCrop.h);
+    }
+}
 
+bool AnnOverlayPlane::setDataBuffer(BufferMapper& mapper)
+{
     if (OverlayPlaneBase::setDataBuffer(mapper) == false) {
         return false;
     }
@@ -711,11 +738,7 @@ bool AnnOverlayPlane::initialize(uint32_t bufferCount)
         return false;
     }
 
-    // setup rotation buffer
-    mRotationBufProvider = new RotationBufferProvider(mWsbm);
-    if (!mRotationBufProvider || !mRotationBufProvider->initialize()) {
-        DEINIT_AND_RETURN_FALSE("failed to initialize RotationBufferProvider");
-    }
+    // rotation buffer provider is created on the first rotated frame
     return true;
 }
 
@@ -737,27 +760,37 @@ bool AnnOverlayPlane::rotatedBufferReady(BufferMapper& mapper, BufferMapper* &ro
         return false;
     }
 
-    payload = (struct VideoPayloadBuffer *)mapper.getCpuAddress(SUB_BUFFER1);
+    payload = readPayload(mapper);
     // check payload
     if (!payload) {
         ELOGTRACE("no payload found");
         return false;
     }
 
-    if (payload->force_output_method == FORCE_OUTPUT_GPU) {
+    if (mPayload.force_output_method == FORCE_OUTPUT_GPU) {
         ELOGTRACE("Output method is not supported!");
         return false;
     }
 
-    if (payload->client_transform != mTransform ||
+    if (mPayload.client_transform != mTransform ||
         mBobDeinterlace) {
+        if (!mRotationBufProvider) {
+            mRotationBufProvider = new RotationBufferProvider(mWsbm);
+            if (!mRotationBufProvider || !mRotationBufProvider->initialize()) {
+                ELOGTRACE("failed to initialize RotationBufferProvider");
+                DEINIT_AND_DELETE_OBJ(mRotationBufProvider);
+                return false;
+            }
+        }
         if (!mRotationBufProvider->setupRotationBuffer(payload, mTransform)) {
             DLOGTRACE("failed to setup rotation buffer");
             return false;
         }
+        // rotation buffer provider updated the payload
+        readPayload(mapper, true);
     }
 
-    rotatedMapper = getTTMMapper(mapper, payload);
+    rotatedMapper = getTTMMapper(mapper, mPayload);
     return true;
 }
 
@@ -773,7 +806,7 @@ void AnnOverlayPlane::signalVideoRotation(BufferMapper& mapper)
         return;
     }
 
-    payload = (struct VideoPayloadBuffer *)mapper.getCpuAddress(SUB_BUFFER1);
+    payload = readPayload(mapper);
     if (!payload) {
         ELOGTRACE("no payload found");
         return;
@@ -781,14 +814,14 @@ void AnnOverlayPlane::signalVideoRotation(BufferMapper& mapper)
 
     /* if use overlay rotation, signal decoder to stop rotation */
     if (mUseOverlayRotation) {
-        if (payload->client_transform) {
+        if (mPayload.client_transform) {
             WLOGTRACE("signal decoder to stop generate rotation buffer");
             payload->hwc_timestamp = systemTime();
             payload->layer_transform = 0;
         }
     } else {
         /* if overlay rotation cannot be used, signal decoder to start rotation */
-        if (payload->client_transform != mTransform) {
+        if (mPayload.client_transform != mTransform) {
             WLOGTRACE("signal decoder to generate rotation buffer with transform %d", mTransform);
             payload->hwc_timestamp = systemTime();
             payload->layer_transform = mTransform;
@@ -888,5 +921,25 @@ bool AnnOverlayPlane::flush(uint32_t flags)
     return true;
 }
 
+bool AnnOverlayPlane::updateOverlayAddress(uint32_t ovadd)
+{
+    RETURN_FALSE_IF_NOT_INIT();
+
+    struct drm_psb_register_rw_arg arg;
+    memset(&arg, 0, sizeof(struct drm_psb_register_rw_arg));
+
+    arg.plane_enable_mask = 1;
+    arg.plane.type = DC_OVERLAY_PLANE;
+    arg.plane.index = mIndex;
+    arg.plane.ctx = ovadd;
+
+    Drm *drm = Hwcomposer::getInstance().getDrm();
+    if (!drm->writeReadIoctl(DRM_PSB_REGISTER_RW, &arg, sizeof(arg))) {
+        WLOGTRACE("overlay %d address update failed", mIndex);
+        return false;
+    }
+    return true;
+}
+
 } // namespace intel
 } // namespace android
@@ -52,9 +52,12 @@ public:
 private:
     void signalVideoRotation(BufferMapper& mapper);
     bool isSettingRotBitAllowed();
+    uint32_t getOverlayAddress(int buf);
 protected:
     virtual bool setDataBuffer(BufferMapper& mapper);
+    virtual void checkDownscale(BufferMapper& mapper);
     virtual bool flush(uint32_t flags);
+    virtual bool updateOverlayAddress(uint32_t ovadd);
     virtual bool bufferOffsetSetup(BufferMapper& mapper);
     virtual bool coordinateSetup(BufferMapper& mapper);
     virtual bool scalingSetup(BufferMapper& mapper);
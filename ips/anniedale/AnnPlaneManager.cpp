@@ -128,6 +128,8 @@ bool AnnPlaneManager::initialize()
     mPrimaryPlaneCount = 3; // Primary A, B, C
     mCursorPlaneCount = 3;
 
+    PlaneCapabilities::initialize();
+
     return DisplayPlaneManager::initialize();
 }
 
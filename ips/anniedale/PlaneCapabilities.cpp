@@ -14,6 +14,7 @@
 // limitations under the License.
 */
 
+#include <string.h>
 #include <common/utils/HwcTrace.h>
 #include <DisplayPlane.h>
 #include <PlaneCapabilities.h>
@@ -31,138 +32,214 @@
 namespace android {
 namespace intel {
 
-bool PlaneCapabilities::isFormatSupported(int planeType, HwcLayer *hwcLayer)
+enum {
+    FORMAT_BGRA_8888 = 0,
+    FORMAT_BGRX_8888,
+    FORMAT_RGBA_8888,
+    FORMAT_RGBX_8888,
+    FORMAT_RGB_565,
+    FORMAT_YV12,
+    FORMAT_I420,
+    FORMAT_YUY2,
+    FORMAT_UYVY,
+    FORMAT_NV12,
+    FORMAT_NV12_PACKED,
+    FORMAT_NV12_TILED,
+    FORMAT_COUNT,
+};
+
+enum {
+    BLENDING_NONE     = 0x1,
+    BLENDING_PREMULT  = 0x2,
+    BLENDING_COVERAGE = 0x4,
+};
+
+#define TRANSFORM_BIT(t)        ((t) < 8 ? (1 << (t)) : 0)
+#define TRANSFORM_ROTATIONS     (TRANSFORM_BIT(0) | \
+                                 TRANSFORM_BIT(HAL_TRANSFORM_ROT_90) | \
+                                 TRANSFORM_BIT(HAL_TRANSFORM_ROT_180) | \
+                                 TRANSFORM_BIT(HAL_TRANSFORM_ROT_270))
+
+// indexed by FORMAT_*
+static const uint32_t sFormats[FORMAT_COUNT] = {
+    HAL_PIXEL_FORMAT_BGRA_8888,
+    HAL_PIXEL_FORMAT_BGRX_8888,
+    HAL_PIXEL_FORMAT_RGBA_8888,
+    HAL_PIXEL_FORMAT_RGBX_8888,
+    HAL_PIXEL_FORMAT_RGB_565,
+    HAL_PIXEL_FORMAT_YV12,
+    HAL_PIXEL_FORMAT_I420,
+    HAL_PIXEL_FORMAT_YUY2,
+    HAL_PIXEL_FORMAT_UYVY,
+    HAL_PIXEL_FORMAT_NV12,
+    OMX_INTEL_COLOR_FormatYUV420PackedSemiPlanar,
+    OMX_INTEL_COLOR_FormatYUV420PackedSemiPlanar_Tiled,
+};
+
+struct FormatCaps {
+    // one bit per supported HAL transform, 0 if format is not supported
+    uint8_t transforms;
+    uint32_t maxStride;
+};
+
+struct PlaneCaps {
+    // one bit per supported HAL transform
+    uint8_t transforms;
+    // BLENDING_* bits
+    uint8_t blendings;
+    bool scaling;
+    // scans out render compressed surfaces
+    bool compression;
+};
+
+static FormatCaps sFormatCaps[DisplayPlane::PLANE_MAX][FORMAT_COUNT];
+static PlaneCaps sPlaneCaps[DisplayPlane::PLANE_MAX];
+
+static inline bool isValidPlaneType(int planeType)
 {
-    uint32_t format = hwcLayer->getFormat();
-    uint32_t trans = hwcLayer->getLayer()->transform;
+    if (planeType < 0 || planeType >= DisplayPlane::PLANE_MAX) {
+        ELOGTRACE("invalid plane type %d", planeType);
+        return false;
+    }
+    return true;
+}
 
-    if (planeType == DisplayPlane::PLANE_SPRITE || planeType == DisplayPlane::PLANE_PRIMARY) {
-        switch (format) {
-        case HAL_PIXEL_FORMAT_BGRA_8888:
-        case HAL_PIXEL_FORMAT_BGRX_8888:
-        case HAL_PIXEL_FORMAT_RGBA_8888:
-        case HAL_PIXEL_FORMAT_RGBX_8888:
-        case HAL_PIXEL_FORMAT_RGB_565:
-            return trans ? false : true;
-        default:
-            VLOGTRACE("unsupported format %#x", format);
-            return false;
+static inline int getFormatIndex(uint32_t format)
+{
+    for (int i = 0; i < FORMAT_COUNT; i++) {
+        if (sFormats[i] == format) {
+            return i;
         }
-    } else if (planeType == DisplayPlane::PLANE_OVERLAY) {
-        switch (format) {
-        case HAL_PIXEL_FORMAT_I420:
-        case HAL_PIXEL_FORMAT_YUY2:
-        case HAL_PIXEL_FORMAT_UYVY:
-            // TODO: overlay supports 180 degree rotation
-            if (trans == HAL_TRANSFORM_ROT_180) {
-                WLOGTRACE("180 degree rotation is not supported yet");
-            }
-            return trans ? false : true;
-        case HAL_PIXEL_FORMAT_YV12:
-            return trans ? false: true;
-        case HAL_PIXEL_FORMAT_NV12:
-        case OMX_INTEL_COLOR_FormatYUV420PackedSemiPlanar:
-        case OMX_INTEL_COLOR_FormatYUV420PackedSemiPlanar_Tiled:
-            return true;
-        default:
-            VLOGTRACE("unsupported format %#x", format);
-            return false;
+    }
+    return -1;
+}
+
+static inline uint8_t getBlendingBit(uint32_t blending)
+{
+    switch (blending) {
+    case HWC_BLENDING_NONE:
+        return BLENDING_NONE;
+    case HWC_BLENDING_PREMULT:
+        return BLENDING_PREMULT;
+    case HWC_BLENDING_COVERAGE:
+        return BLENDING_COVERAGE;
+    default:
+        return 0;
+    }
+}
+
+static inline const FormatCaps* getFormatCaps(int planeType, uint32_t format)
+{
+    int index = getFormatIndex(format);
+    if (index < 0 || !sFormatCaps[planeType][index].transforms) {
+        VLOGTRACE("unsupported format %#x", format);
+        return NULL;
+    }
+    return &sFormatCaps[planeType][index];
+}
+
+void PlaneCapabilities::initialize()
+{
+    memset(sFormatCaps, 0, sizeof(sFormatCaps));
+    memset(sPlaneCaps, 0, sizeof(sPlaneCaps));
+
+    // sprite & primary: RGB only, no transform, no scaling
+    const int rgbPlanes[] = {
+        DisplayPlane::PLANE_SPRITE,
+        DisplayPlane::PLANE_PRIMARY,
+    };
+    for (size_t i = 0; i < sizeof(rgbPlanes) / sizeof(rgbPlanes[0]); i++) {
+        int type = rgbPlanes[i];
+        for (int f = FORMAT_BGRA_8888; f <= FORMAT_RGB_565; f++) {
+            sFormatCaps[type][f].transforms = TRANSFORM_BIT(0);
+            sFormatCaps[type][f].maxStride = SPRITE_PLANE_MAX_STRIDE_LINEAR;
         }
-    } else {
-        ELOGTRACE("invalid plane type %d", planeType);
+        sPlaneCaps[type].transforms = TRANSFORM_BIT(0);
+        // add coverage alpha support for ann
+        sPlaneCaps[type].blendings =
+            BLENDING_NONE | BLENDING_PREMULT | BLENDING_COVERAGE;
+        sPlaneCaps[type].scaling = false;
+        sPlaneCaps[type].compression = true;
+    }
+
+    // overlay: YUV only, rotation for NV12 only, no blending
+    FormatCaps *overlay = sFormatCaps[DisplayPlane::PLANE_OVERLAY];
+    for (int f = FORMAT_YV12; f <= FORMAT_NV12_TILED; f++) {
+        overlay[f].transforms = TRANSFORM_BIT(0);
+        overlay[f].maxStride = OVERLAY_PLANE_MAX_STRIDE_LINEAR;
+    }
+    // TODO: overlay supports 180 degree rotation for the other formats
+    overlay[FORMAT_NV12].transforms = TRANSFORM_ROTATIONS;
+    overlay[FORMAT_NV12_PACKED].transforms = TRANSFORM_ROTATIONS;
+    overlay[FORMAT_NV12_TILED].transforms = TRANSFORM_ROTATIONS;
+    overlay[FORMAT_YUY2].maxStride = OVERLAY_PLANE_MAX_STRIDE_PACKED;
+    overlay[FORMAT_UYVY].maxStride = OVERLAY_PLANE_MAX_STRIDE_PACKED;
+
+    // overlay does not support FLIP_H/FLIP_V
+    sPlaneCaps[DisplayPlane::PLANE_OVERLAY].transforms = TRANSFORM_ROTATIONS;
+    sPlaneCaps[DisplayPlane::PLANE_OVERLAY].blendings = BLENDING_NONE;
+    sPlaneCaps[DisplayPlane::PLANE_OVERLAY].scaling = true;
+    sPlaneCaps[DisplayPlane::PLANE_OVERLAY].compression = false;
+}
+
+bool PlaneCapabilities::isFormatSupported(int planeType, HwcLayer *hwcLayer)
+{
+    if (!isValidPlaneType(planeType)) {
+        return false;
+    }
+
+    const FormatCaps *caps = getFormatCaps(planeType, hwcLayer->getFormat());
+    if (!caps) {
         return false;
     }
+
+    uint32_t trans = hwcLayer->getLayer()->transform;
+    return (caps->transforms & TRANSFORM_BIT(trans)) ? true : false;
 }
 
 bool PlaneCapabilities::isSizeSupported(int planeType, HwcLayer *hwcLayer)
 {
-    uint32_t format = hwcLayer->getFormat();
-    uint32_t w = hwcLayer->getBufferWidth();
-    uint32_t h = hwcLayer->getBufferHeight();
-    const stride_t& stride = hwcLayer->getBufferStride();
+    if (!isValidPlaneType(planeType)) {
+        return false;
+    }
 
-    bool isYUVPacked;
-    uint32_t maxStride;
+    const FormatCaps *caps = getFormatCaps(planeType, hwcLayer->getFormat());
+    if (!caps) {
+        return false;
+    }
 
-    if (planeType == DisplayPlane::PLANE_SPRITE || planeType == DisplayPlane::PLANE_PRIMARY) {
-        switch (format) {
-        case HAL_PIXEL_FORMAT_BGRA_8888:
-        case HAL_PIXEL_FORMAT_BGRX_8888:
-        case HAL_PIXEL_FORMAT_RGBA_8888:
-        case HAL_PIXEL_FORMAT_RGBX_8888:
-        case HAL_PIXEL_FORMAT_RGB_565:
-            VLOGTRACE("stride %d", stride.rgb.stride);
-            if (stride.rgb.stride > SPRITE_PLANE_MAX_STRIDE_LINEAR) {
-                VLOGTRACE("too large stride %d", stride.rgb.stride);
-                return false;
-            }
-            return true;
-        default:
-            VLOGTRACE("unsupported format %#x", format);
-            return false;
-        }
-    } else if (planeType == DisplayPlane::PLANE_OVERLAY) {
-        switch (format) {
-        case HAL_PIXEL_FORMAT_YV12:
-        case HAL_PIXEL_FORMAT_I420:
-        case HAL_PIXEL_FORMAT_NV12:
-        case OMX_INTEL_COLOR_FormatYUV420PackedSemiPlanar:
-        case OMX_INTEL_COLOR_FormatYUV420PackedSemiPlanar_Tiled:
-            isYUVPacked = false;
-            break;
-        case HAL_PIXEL_FORMAT_YUY2:
-        case HAL_PIXEL_FORMAT_UYVY:
-            isYUVPacked = true;
-            break;
-        default:
-            VLOGTRACE("unsupported format %#x", format);
-            return false;
-        }
-        // don't use overlay plane if stride is too big
-        maxStride = OVERLAY_PLANE_MAX_STRIDE_LINEAR;
-        if (isYUVPacked) {
-            maxStride = OVERLAY_PLANE_MAX_STRIDE_PACKED;
-        }
+    const stride_t& stride = hwcLayer->getBufferStride();
+    uint32_t pitch = (planeType == DisplayPlane::PLANE_OVERLAY) ?
+        stride.yuv.yStride : stride.rgb.stride;
 
-        if (stride.yuv.yStride > maxStride) {
-            VLOGTRACE("stride %d is too large", stride.yuv.yStride);
-            return false;
-        }
-        return true;
-    } else {
-        ELOGTRACE("invalid plane type %d", planeType);
+    // don't use the plane if stride is too big
+    if (pitch > caps->maxStride) {
+        VLOGTRACE("stride %d is too large", pitch);
         return false;
     }
+    return true;
 }
 
 bool PlaneCapabilities::isBlendingSupported(int planeType, HwcLayer *hwcLayer)
 {
-    uint32_t blending = (uint32_t)hwcLayer->getLayer()->blending;
-    uint8_t planeAlpha = hwcLayer->getLayer()->planeAlpha;
+    if (!isValidPlaneType(planeType)) {
+        return false;
+    }
 
-    if (planeType == DisplayPlane::PLANE_SPRITE || planeType == DisplayPlane::PLANE_PRIMARY) {
-        // support premultipled & none blanding
-        switch (blending) {
-        case HWC_BLENDING_NONE:
-        case HWC_BLENDING_PREMULT:
-        // add coverage alpha support for ann
-        case HWC_BLENDING_COVERAGE:
-            return true;
-        default:
-            VLOGTRACE("unsupported blending %#x", blending);
-            return false;
-        }
-    } else if (planeType == DisplayPlane::PLANE_OVERLAY) {
-        // overlay doesn't support blending
-        return (blending == HWC_BLENDING_NONE) ? true : false;
-    } else {
-        ELOGTRACE("invalid plane type %d", planeType);
+    uint32_t blending = (uint32_t)hwcLayer->getLayer()->blending;
+    if (!(sPlaneCaps[planeType].blendings & getBlendingBit(blending))) {
+        VLOGTRACE("unsupported blending %#x", blending);
         return false;
     }
+    return true;
 }
 
 bool PlaneCapabilities::isScalingSupported(int planeType, HwcLayer *hwcLayer)
 {
+    if (!isValidPlaneType(planeType)) {
+        return false;
+    }
+
     hwc_frect_t& src = hwcLayer->getLayer()->sourceCropf;
     hwc_rect_t& dest = hwcLayer->getLayer()->displayFrame;
     uint32_t trans = hwcLayer->getLayer()->transform;
@@ -175,70 +252,121 @@ bool PlaneCapabilities::isScalingSupported(int planeType, HwcLayer *hwcLayer)
     dstW = dest.right - dest.left;
     dstH = dest.bottom - dest.top;
 
-    if (planeType == DisplayPlane::PLANE_SPRITE || planeType == DisplayPlane::PLANE_PRIMARY) {
+    if (!sPlaneCaps[planeType].scaling) {
         // no scaling is supported
         return ((srcW == dstW) && (srcH == dstH)) ? true : false;
+    }
+
+    // overlay cannot support resolution that bigger than 2047x2047.
+    if ((srcW > INTEL_OVERLAY_MAX_WIDTH - 1) || (srcH > INTEL_OVERLAY_MAX_HEIGHT - 1)) {
+        return false;
+    }
+
+    if (dstW <= 1 || dstH <= 1 || srcW <= 1 || srcH <= 1) {
+        // Workaround: Overlay flip when height is 1 causes MIPI stall on TNG
+        DLOGTRACE("invalid destination size: %dx%d, fall back to GLES", dstW, dstH);
+        return false;
+    }
 
-    } else if (planeType == DisplayPlane::PLANE_OVERLAY) {
-        // overlay cannot support resolution that bigger than 2047x2047.
-        if ((srcW > INTEL_OVERLAY_MAX_WIDTH - 1) || (srcH > INTEL_OVERLAY_MAX_HEIGHT - 1)) {
+    if (trans == HAL_TRANSFORM_ROT_90 || trans == HAL_TRANSFORM_ROT_270) {
+        int tmp = srcW;
+        srcW = srcH;
+        srcH = tmp;
+    }
+
+    if (!hwcLayer->isProtected()) {
+        if ((int)src.left & 63) {
+            DLOGTRACE("offset %d is not 64 bytes aligned, fall back to GLES", (int)src.left);
             return false;
         }
 
-        if (dstW <= 1 || dstH <= 1 || srcW <= 1 || srcH <= 1) {
-            // Workaround: Overlay flip when height is 1 causes MIPI stall on TNG
-            DLOGTRACE("invalid destination size: %dx%d, fall back to GLES", dstW, dstH);
+        float scaleX = (float)srcW / dstW;
+        float scaleY = (float)srcH / dstH;
+        if (scaleX > 4.0 || scaleY > 4.0 || scaleX < 0.25 || scaleY < 0.25) {
+            WLOGTRACE("overlay scaling > 4, fall back to GLES");
             return false;
         }
+    }
 
-        if (trans == HAL_TRANSFORM_ROT_90 || trans == HAL_TRANSFORM_ROT_270) {
-            int tmp = srcW;
-            srcW = srcH;
-            srcH = tmp;
-        }
+    return true;
+}
 
-        if (!hwcLayer->isProtected()) {
-            if ((int)src.left & 63) {
-                DLOGTRACE("offset %d is not 64 bytes aligned, fall back to GLES", (int)src.left);
-                return false;
-            }
-
-            float scaleX = (float)srcW / dstW;
-            float scaleY = (float)srcH / dstH;
-            if (scaleX > 4.0 || scaleY > 4.0 || scaleX < 0.25 || scaleY < 0.25) {
-                WLOGTRACE("overlay scaling > 4, fall back to GLES");
-                return false;
-            }
-        }
+bool PlaneCapabilities::isTransformSupported(int planeType, HwcLayer *hwcLayer)
+{
+    if (!isValidPlaneType(planeType)) {
+        return false;
+    }
 
-        return true;
-    } else {
-        ELOGTRACE("invalid plane type %d", planeType);
+    uint32_t trans = hwcLayer->getLayer()->transform;
+    return (sPlaneCaps[planeType].transforms & TRANSFORM_BIT(trans)) ? true : false;
+}
+
+bool PlaneCapabilities::isCompressionSupported(int planeType, HwcLayer *hwcLayer)
+{
+    if (!isValidPlaneType(planeType)) {
+        return false;
+    }
+
+    if (hwcLayer->isCompressed() && !sPlaneCaps[planeType].compression) {
+        VLOGTRACE("plane type %d can't scan out compressed buffer", planeType);
         return false;
     }
+    return true;
 }
 
-bool PlaneCapabilities::isTransformSupported(int planeType, HwcLayer *hwcLayer)
+bool PlaneCapabilities::isFbScalingSupported(int planeType, HwcLayer *hwcLayer,
+                                             uint32_t dstW, uint32_t dstH)
 {
-    uint32_t trans = hwcLayer->getLayer()->transform;
+    if (!isValidPlaneType(planeType)) {
+        return false;
+    }
 
-    if (planeType == DisplayPlane::PLANE_OVERLAY) {
-        // overlay does not support FLIP_H/FLIP_V
-        switch (trans) {
-        case 0:
-        case HAL_TRANSFORM_ROT_90:
-        case HAL_TRANSFORM_ROT_180:
-        case HAL_TRANSFORM_ROT_270:
-            return true;
-        default:
-            return false;
-        }
+    if (!sPlaneCaps[planeType].scaling) {
+        return false;
+    }
+
+    if (!isCompressionSupported(planeType, hwcLayer)) {
+        return false;
+    }
+
+    // overlay fetches 32-bit BGR without color conversion
+    uint32_t format = hwcLayer->getFormat();
+    if (format != HAL_PIXEL_FORMAT_BGRA_8888 &&
+        format != HAL_PIXEL_FORMAT_BGRX_8888) {
+        VLOGTRACE("unsupported frame buffer format %#x", format);
+        return false;
     }
 
-    // don't transform any tranform
-    return trans ? false : true;
+    const stride_t& stride = hwcLayer->getBufferStride();
+    if (stride.rgb.stride > OVERLAY_PLANE_MAX_STRIDE_PACKED) {
+        VLOGTRACE("frame buffer stride %d is too large", stride.rgb.stride);
+        return false;
+    }
+
+    hwc_frect_t& src = hwcLayer->getLayer()->sourceCropf;
+    uint32_t srcW = (int)src.right - (int)src.left;
+    uint32_t srcH = (int)src.bottom - (int)src.top;
+    if (!srcW || !srcH) {
+        srcW = hwcLayer->getBufferWidth();
+        srcH = hwcLayer->getBufferHeight();
+    }
+
+    if (srcW > INTEL_OVERLAY_MAX_WIDTH - 1 || srcH > INTEL_OVERLAY_MAX_HEIGHT - 1) {
+        return false;
+    }
+
+    if (dstW <= 1 || dstH <= 1) {
+        return false;
+    }
+
+    float scaleX = (float)srcW / dstW;
+    float scaleY = (float)srcH / dstH;
+    if (scaleX > 4.0 || scaleY > 4.0 || scaleX < 0.25 || scaleY < 0.25) {
+        VLOGTRACE("frame buffer scaling %.2fx%.2f is out of overlay range", scaleX, scaleY);
+        return false;
+    }
+    return true;
 }
 
 } // namespace intel
 } // namespace android
-
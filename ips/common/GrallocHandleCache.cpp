@@ -0,0 +1,147 @@
+/*
+// Copyright (c) 2014 Intel Corporation 
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#include <string.h>
+#include <unistd.h>
+#include <common/utils/HwcTrace.h>
+#include <ips/common/GrallocHandleCache.h>
+
+namespace android {
+namespace intel {
+
+GrallocHandleCache::GrallocHandleCache()
+    : mHandles(),
+      mIdleHandles(),
+      mClones(0),
+      mReuses(0)
+{
+    mIdleHandles.setCapacity(MAX_IDLE_HANDLE_COUNT + 1);
+}
+
+GrallocHandleCache::~GrallocHandleCache()
+{
+    deinitialize();
+}
+
+void GrallocHandleCache::deinitialize()
+{
+    Mutex::Autolock _l(mLock);
+
+    for (size_t i = 0; i < mHandles.size(); i++) {
+        const HandleEntry& entry = mHandles.valueAt(i);
+        if (entry.refCount) {
+            WLOGTRACE("handle %#llx is still referenced", mHandles.keyAt(i));
+        }
+        destroyHandle(entry.handle);
+    }
+    mHandles.clear();
+    mIdleHandles.clear();
+}
+
+void GrallocHandleCache::destroyHandle(native_handle_t *handle)
+{
+    native_handle_close(handle);
+    native_handle_delete(handle);
+}
+
+native_handle_t* GrallocHandleCache::acquire(uint64_t key,
+                                             const native_handle_t *handle)
+{
+    if (!handle) {
+        return NULL;
+    }
+
+    Mutex::Autolock _l(mLock);
+
+    ssize_t index = mHandles.indexOfKey(key);
+    if (index >= 0) {
+        HandleEntry& entry = mHandles.editValueAt(index);
+        if (entry.refCount == 0) {
+            // revive an idle clone
+            for (size_t i = 0; i < mIdleHandles.size(); i++) {
+                if (mIdleHandles.itemAt(i) == key) {
+                    mIdleHandles.removeAt(i);
+                    break;
+                }
+            }
+        }
+        entry.refCount++;
+        mReuses++;
+        return entry.handle;
+    }
+
+    native_handle_t *clone = native_handle_create(handle->numFds, handle->numInts);
+    if (!clone) {
+        ELOGTRACE("failed to create handle, out of memory");
+        return NULL;
+    }
+    for (int i = 0; i < handle->numFds; i++) {
+        clone->data[i] = (handle->data[i] >= 0) ? dup(handle->data[i]) : -1;
+    }
+    memcpy(clone->data + handle->numFds,
+           handle->data + handle->numFds,
+           handle->numInts * sizeof(int));
+
+    HandleEntry entry;
+    entry.handle = clone;
+    entry.refCount = 1;
+    mHandles.add(key, entry);
+    mClones++;
+    return clone;
+}
+
+void GrallocHandleCache::release(uint64_t key)
+{
+    Mutex::Autolock _l(mLock);
+
+    ssize_t index = mHandles.indexOfKey(key);
+    if (index < 0) {
+        ELOGTRACE("unknown handle %#llx", key);
+        return;
+    }
+
+    HandleEntry& entry = mHandles.editValueAt(index);
+    if (--entry.refCount > 0) {
+        return;
+    }
+
+    mIdleHandles.push_back(key);
+    if (mIdleHandles.size() <= MAX_IDLE_HANDLE_COUNT) {
+        return;
+    }
+
+    // drop the least recently released clone
+    uint64_t oldest = mIdleHandles.itemAt(0);
+    mIdleHandles.removeAt(0);
+    index = mHandles.indexOfKey(oldest);
+    if (index >= 0) {
+        destroyHandle(mHandles.valueAt(index).handle);
+        mHandles.removeItemsAt(index);
+    }
+}
+
+void GrallocHandleCache::dump(Dump& d)
+{
+    Mutex::Autolock _l(mLock);
+
+    d.append("Handle clones: %d live, %d idle, %d created, %d reused\n",
+             mHandles.size() - mIdleHandles.size(),
+             mIdleHandles.size(),
+             mClones,
+             mReuses);
+}
+
+} // namespace intel
+} // namespace android
@@ -0,0 +1,68 @@
+/*
+// Copyright (c) 2014 Intel Corporation 
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#ifndef GRALLOC_HANDLE_CACHE_H
+#define GRALLOC_HANDLE_CACHE_H
+
+#include <cutils/native_handle.h>
+#include <utils/KeyedVector.h>
+#include <utils/Vector.h>
+#include <utils/Mutex.h>
+#include <common/utils/Dump.h>
+
+namespace android {
+namespace intel {
+
+// Reference counted clones of gralloc handles, keyed by buffer stamp.
+// All mappers of a buffer share one clone, and a few released clones
+// are kept around so a buffer that gets remapped doesn't dup its fds
+// again.
+class GrallocHandleCache {
+public:
+    GrallocHandleCache();
+    ~GrallocHandleCache();
+
+public:
+    void deinitialize();
+    native_handle_t* acquire(uint64_t key, const native_handle_t *handle);
+    void release(uint64_t key);
+    void dump(Dump& d);
+
+private:
+    void destroyHandle(native_handle_t *handle);
+
+private:
+    enum {
+        // released clones still pin their buffers, keep this small
+        MAX_IDLE_HANDLE_COUNT = 8,
+    };
+
+    struct HandleEntry {
+        native_handle_t *handle;
+        int refCount;
+    };
+
+    KeyedVector<uint64_t, HandleEntry> mHandles;
+    // keys of released clones, oldest first
+    Vector<uint64_t> mIdleHandles;
+    uint32_t mClones;
+    uint32_t mReuses;
+    Mutex mLock;
+};
+
+} // namespace intel
+} // namespace android
+
+#endif /* GRALLOC_HANDLE_CACHE_H */
@@ -13,6 +13,12 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 */
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
 #include <common/utils/HwcTrace.h>
 #include <DrmConfig.h>
 #include <Hwcomposer.h>
@@ -30,26 +36,28 @@ HdcpControl::HdcpControl()
       mUserData(NULL),
       mCallbackState(CALLBACK_PENDING),
       mMutex(),
-      mStoppedCondition(),
       mCompletedCondition(),
       mWaitForCompletion(false),
-      mStopped(true),
       mAuthenticated(false),
-      mActionDelay(0),
       mAuthRetryCount(0),
-      mEnableAuthenticationLog(true)
+      mEnableAuthenticationLog(true),
+      mState(HDCP_STOPPED),
+      mTimerFd(-1),
+      mEventFd(-1),
+      mExiting(false),
+      mAuthStartTime(0)
 {
+    memset(&mStats, 0, sizeof(mStats));
 }
 
 HdcpControl::~HdcpControl()
 {
+    stopHdcp();
+    stopThread();
 }
 
-bool HdcpControl::startHdcp()
+static bool isHdcpEnabled()
 {
-    // this is a blocking and synchronous call
-    Mutex::Autolock lock(mMutex);
-
     char prop[PROPERTY_VALUE_MAX];
     if (property_get("debug.hwc.hdcp.enable", prop, "1") > 0) {
         if (atoi(prop) == 0) {
@@ -57,43 +65,143 @@ bool HdcpControl::startHdcp()
             return false;
         }
     }
+    return true;
+}
 
-    if (!mStopped) {
-        WLOGTRACE("HDCP has been started");
+bool HdcpControl::startThread()
+{
+    // thread is kept parked on its fds while HDCP is stopped
+    if (mThread.get()) {
         return true;
     }
 
-    mStopped = false;
-    mAuthenticated = false;
-    mWaitForCompletion = false;
+    mTimerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (mTimerFd < 0) {
+        ELOGTRACE("failed to create timer fd, error: %s", strerror(errno));
+        mTimerFd = -1;
+        return false;
+    }
+
+    mEventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (mEventFd < 0) {
+        ELOGTRACE("failed to create event fd, error: %s", strerror(errno));
+        close(mTimerFd);
+        mTimerFd = -1;
+        mEventFd = -1;
+        return false;
+    }
 
+    mExiting = false;
     mThread = new HdcpControlThread(this);
     if (!mThread.get()) {
         ELOGTRACE("failed to create hdcp control thread");
+        close(mTimerFd);
+        close(mEventFd);
+        mTimerFd = -1;
+        mEventFd = -1;
         return false;
     }
 
-    if (!runHdcp()) {
-        ELOGTRACE("failed to run HDCP");
-        mStopped = true;
-        mThread = NULL;
+    mThread->run("HdcpControl", PRIORITY_NORMAL);
+    return true;
+}
+
+void HdcpControl::stopThread()
+{
+    {
+        Mutex::Autolock lock(mMutex);
+        if (!mThread.get()) {
+            return;
+        }
+        mExiting = true;
+        uint64_t value = 1;
+        if (write(mEventFd, &value, sizeof(value)) != sizeof(value)) {
+            WLOGTRACE("failed to wake hdcp control thread");
+        }
+    }
+
+    mThread->requestExitAndWait();
+    mThread = NULL;
+
+    close(mTimerFd);
+    close(mEventFd);
+    mTimerFd = -1;
+    mEventFd = -1;
+}
+
+void HdcpControl::armTimer(int delayMs)
+{
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+
+    // zero delay disarms the timer
+    spec.it_value.tv_sec = delayMs / 1000;
+    spec.it_value.tv_nsec = (delayMs % 1000) * 1000000;
+
+    if (timerfd_settime(mTimerFd, 0, &spec, NULL) < 0) {
+        ELOGTRACE("failed to arm hdcp timer, error: %s", strerror(errno));
+    }
+}
+
+void HdcpControl::setState(int state, int delayMs)
+{
+    if (mState != state) {
+        VLOGTRACE("%s -> %s", getStateName(mState), getStateName(state));
+    }
+    mState = state;
+    armTimer(delayMs);
+}
+
+const char* HdcpControl::getStateName(int state)
+{
+    static const char* names[HDCP_STATE_COUNT] = {
+        "stopped",
+        "authenticating",
+        "authenticated",
+        "suspended",
+    };
+
+    if (state < 0 || state >= HDCP_STATE_COUNT) {
+        return "unknown";
+    }
+    return names[state];
+}
+
+bool HdcpControl::startHdcp()
+{
+    // this is a blocking and synchronous call
+    Mutex::Autolock lock(mMutex);
+
+    if (!isHdcpEnabled()) {
         return false;
     }
 
-    mAuthRetryCount = 0;
-    mWaitForCompletion = !mAuthenticated;
-    if (mAuthenticated) {
-        mActionDelay = HDCP_VERIFICATION_DELAY_MS;
-    } else {
-        mActionDelay = HDCP_AUTHENTICATION_SHORT_DELAY_MS;
+    if (mState != HDCP_STOPPED) {
+        WLOGTRACE("HDCP has been started");
+        return true;
     }
 
-    mThread->run("HdcpControl", PRIORITY_NORMAL);
+    if (!startThread()) {
+        return false;
+    }
+
+    mAuthenticated = false;
+    mWaitForCompletion = false;
+    mAuthRetryCount = 0;
+    mAuthStartTime = systemTime(SYSTEM_TIME_MONOTONIC);
+    mState = HDCP_AUTHENTICATING;
 
-    if (!mWaitForCompletion) {
+    if (runHdcp()) {
         // HDCP is authenticated.
+        onAuthenticated();
+        setState(HDCP_AUTHENTICATED, HDCP_VERIFICATION_DELAY_MS);
         return true;
     }
+
+    mStats.failures++;
+    setState(HDCP_AUTHENTICATING, HDCP_AUTHENTICATION_SHORT_DELAY_MS);
+
+    mWaitForCompletion = true;
     status_t err = mCompletedCondition.waitRelative(mMutex, milliseconds(HDCP_AUTHENTICATION_TIMEOUT_MS));
     if (err == -ETIMEDOUT) {
         WLOGTRACE("timeout waiting for completion");
@@ -104,12 +212,8 @@ bool HdcpControl::startHdcp()
 
 bool HdcpControl::startHdcpAsync(HdcpStatusCallback cb, void *userData)
 {
-    char prop[PROPERTY_VALUE_MAX];
-    if (property_get("debug.hwc.hdcp.enable", prop, "1") > 0) {
-        if (atoi(prop) == 0) {
-            WLOGTRACE("HDCP is disabled");
-            return false;
-        }
+    if (!isHdcpEnabled()) {
+        return false;
     }
 
     if (cb == NULL || userData == NULL) {
@@ -119,53 +223,82 @@ bool HdcpControl::startHdcpAsync(HdcpStatusCallback cb, void *userData)
 
     Mutex::Autolock lock(mMutex);
 
-    if (!mStopped) {
+    if (mState != HDCP_STOPPED) {
         WLOGTRACE("HDCP has been started");
         return true;
     }
 
-    mThread = new HdcpControlThread(this);
-    if (!mThread.get()) {
-        ELOGTRACE("failed to create hdcp control thread");
+    if (!startThread()) {
         return false;
     }
 
+    // only arms the timer, authentication runs on the hdcp thread
     mAuthRetryCount = 0;
     mCallback = cb;
     mUserData = userData;
     mCallbackState = CALLBACK_PENDING;
     mWaitForCompletion = false;
     mAuthenticated = false;
-    mStopped = false;
-    mActionDelay = HDCP_ASYNC_START_DELAY_MS;
-    mThread->run("HdcpControl", PRIORITY_NORMAL);
+    mAuthStartTime = systemTime(SYSTEM_TIME_MONOTONIC);
+    setState(HDCP_AUTHENTICATING, HDCP_ASYNC_START_DELAY_MS);
 
     return true;
 }
 
 bool HdcpControl::stopHdcp()
 {
-    do {
-        Mutex::Autolock lock(mMutex);
-        if (mStopped) {
-            return true;
-        }
+    Mutex::Autolock lock(mMutex);
+    if (mState == HDCP_STOPPED) {
+        return true;
+    }
 
-        mStopped = true;
-        mStoppedCondition.signal();
+    // the thread only acts under mMutex, nothing runs after this point
+    setState(HDCP_STOPPED, 0);
+    mAuthenticated = false;
+    signalCompletion();
+    mCallback = NULL;
+    mUserData = NULL;
+    disableAuthentication();
 
-        mAuthenticated = false;
-        mWaitForCompletion = false;
-        mCallback = NULL;
-        mUserData = NULL;
-        disableAuthentication();
-    } while (0);
+    return true;
+}
 
-    if (mThread.get()) {
-        mThread->requestExitAndWait();
-        mThread = NULL;
+bool HdcpControl::suspendHdcp()
+{
+    Mutex::Autolock lock(mMutex);
+    if (mState == HDCP_STOPPED) {
+        return false;
+    }
+    if (mState == HDCP_SUSPENDED) {
+        return true;
     }
 
+    // only the state machine pauses, the session, callback and its
+    // last reported state are kept
+    setState(HDCP_SUSPENDED, 0);
+    signalCompletion();
+    return true;
+}
+
+bool HdcpControl::resumeHdcp()
+{
+    Mutex::Autolock lock(mMutex);
+    if (mState != HDCP_SUSPENDED) {
+        return false;
+    }
+
+    // the link needs a moment to carry video in the new mode, then an
+    // authenticated session is only re-checked, a lost link goes through
+    // the usual re-authentication from there
+    mStats.resumes++;
+    if (mAuthenticated) {
+        setState(HDCP_AUTHENTICATED, HDCP_AUTHENTICATION_SHORT_DELAY_MS);
+        return true;
+    }
+
+    mAuthRetryCount = 0;
+    mAuthStartTime = systemTime(SYSTEM_TIME_MONOTONIC);
+    setState(HDCP_AUTHENTICATING, HDCP_AUTHENTICATION_SHORT_DELAY_MS);
     return true;
 }
 
@@ -270,50 +403,21 @@ bool HdcpControl::checkAuthenticated()
 
 bool HdcpControl::runHdcp()
 {
-    // Default return value is true so HDCP can be re-authenticated in the working thread
-    bool ret = true;
-
+    // one attempt, retries are scheduled by the state machine
     preRunHdcp();
 
-    for (int i = 0; i < HDCP_INLOOP_RETRY_NUMBER; i++) {
-        VLOGTRACE("enable and verify HDCP, iteration# %d", i);
-        if (mStopped) {
-            WLOGTRACE("HDCP authentication has been stopped");
-            ret = false;
-            break;
-        }
-
-        if (!enableAuthentication()) {
-            if (mAuthenticated)
-                ELOGTRACE("HDCP authentication failed. Retry");
-            else
-                VLOGTRACE("HDCP authentication failed. Retry");
-
-            mAuthenticated = false;
-            ret = true;
-        } else {
-            ILOGTRACE("HDCP is authenticated");
-            mAuthenticated = true;
-            ret = true;
-            break;
-        }
-
-        if (mStopped) {
-            WLOGTRACE("HDCP authentication has been stopped");
-            ret = false;
-            break;
-        }
-
-        if (i < HDCP_INLOOP_RETRY_NUMBER - 1) {
-            // Adding delay to make sure panel receives video signal so it can start HDCP authentication.
-            // (HDCP spec 1.3, section 2.3)
-            usleep(HDCP_INLOOP_RETRY_DELAY_US);
-        }
+    mStats.attempts++;
+    if (!enableAuthentication()) {
+        VLOGTRACE("HDCP authentication failed, attempt# %d", mAuthRetryCount);
+        mAuthenticated = false;
+    } else {
+        ILOGTRACE("HDCP is authenticated");
+        mAuthenticated = true;
     }
 
     postRunHdcp();
 
-    return ret;
+    return mAuthenticated;
 }
 
 bool HdcpControl::preRunHdcp()
@@ -338,55 +442,147 @@ void HdcpControl::signalCompletion()
     }
 }
 
-bool HdcpControl::threadLoop()
+void HdcpControl::onAuthenticated()
 {
-    Mutex::Autolock lock(mMutex);
-    status_t err = mStoppedCondition.waitRelative(mMutex, milliseconds(mActionDelay));
-    if (err != -ETIMEDOUT) {
-        ILOGTRACE("Hdcp is stopped.");
-        signalCompletion();
-        return false;
+    nsecs_t elapsed = systemTime(SYSTEM_TIME_MONOTONIC) - mAuthStartTime;
+
+    mAuthRetryCount = 0;
+    mStats.authentications++;
+    mStats.lastAuthTime = elapsed;
+    mStats.totalAuthTime += elapsed;
+    if (!mStats.minAuthTime || elapsed < mStats.minAuthTime) {
+        mStats.minAuthTime = elapsed;
+    }
+    if (elapsed > mStats.maxAuthTime) {
+        mStats.maxAuthTime = elapsed;
     }
+    ILOGTRACE("HDCP authenticated in %lld ms", elapsed / 1000000);
+}
 
-    // default is to keep thread active
-    bool ret = true;
-    if (!mAuthenticated) {
-        ret = runHdcp();
-        mAuthRetryCount++;
-    } else {
-        mAuthRetryCount = 0;
-        checkAuthenticated();
+void HdcpControl::notifyStatus()
+{
+    if (!mCallback) {
+        return;
     }
 
-    // set next action delay
-    if (mAuthenticated) {
-        mActionDelay = HDCP_VERIFICATION_DELAY_MS;
-    } else {
+    if ((mAuthenticated && mCallbackState == CALLBACK_AUTHENTICATED) ||
+        (!mAuthenticated && mCallbackState == CALLBACK_NOT_AUTHENTICATED)) {
+        // ignore callback as state is not changed
+        return;
+    }
+
+    mCallbackState =
+        mAuthenticated ? CALLBACK_AUTHENTICATED : CALLBACK_NOT_AUTHENTICATED;
+    (*mCallback)(mAuthenticated, mUserData);
+}
+
+void HdcpControl::onTimer()
+{
+    switch (mState) {
+    case HDCP_AUTHENTICATING:
+        if (runHdcp()) {
+            onAuthenticated();
+            setState(HDCP_AUTHENTICATED, HDCP_VERIFICATION_DELAY_MS);
+            signalCompletion();
+            break;
+        }
+        mStats.failures++;
+        mAuthRetryCount++;
         // If HDCP can not authenticate after "HDCP_RETRY_LIMIT" attempts
         // reduce HDCP retry frequency to 2 sec
         if (mAuthRetryCount >= HDCP_RETRY_LIMIT) {
-            mActionDelay = HDCP_AUTHENTICATION_LONG_DELAY_MS;
+            setState(HDCP_AUTHENTICATING, HDCP_AUTHENTICATION_LONG_DELAY_MS);
         } else {
-            mActionDelay = HDCP_AUTHENTICATION_SHORT_DELAY_MS;
+            setState(HDCP_AUTHENTICATING, HDCP_AUTHENTICATION_SHORT_DELAY_MS);
+        }
+        break;
+    case HDCP_AUTHENTICATED:
+        if (checkAuthenticated()) {
+            setState(HDCP_AUTHENTICATED, HDCP_VERIFICATION_DELAY_MS);
+            break;
         }
+        WLOGTRACE("HDCP link is lost, re-authenticating");
+        mStats.linkLosses++;
+        mAuthRetryCount = 0;
+        mAuthStartTime = systemTime(SYSTEM_TIME_MONOTONIC);
+        setState(HDCP_AUTHENTICATING, HDCP_AUTHENTICATION_SHORT_DELAY_MS);
+        break;
+    default:
+        // stale expiry from a state that has been left
+        return;
     }
 
-    // TODO: move out of lock?
-    if (!ret || mAuthenticated) {
-        signalCompletion();
+    notifyStatus();
+}
+
+bool HdcpControl::threadLoop()
+{
+    struct pollfd fds[2];
+    uint64_t value;
+
+    fds[0].fd = mTimerFd;
+    fds[0].events = POLLIN;
+    fds[0].revents = 0;
+    fds[1].fd = mEventFd;
+    fds[1].events = POLLIN;
+    fds[1].revents = 0;
+
+    int nr = poll(fds, 2, -1);
+    if (nr < 0) {
+        if (errno == EINTR) {
+            return true;
+        }
+        ELOGTRACE("poll failed, error: %s", strerror(errno));
+        return false;
     }
 
-    if (mCallback) {
-         if ((mAuthenticated && mCallbackState == CALLBACK_AUTHENTICATED) ||
-            (!mAuthenticated && mCallbackState == CALLBACK_NOT_AUTHENTICATED)) {
-            // ignore callback as state is not changed
-        } else {
-            mCallbackState =
-                mAuthenticated ? CALLBACK_AUTHENTICATED : CALLBACK_NOT_AUTHENTICATED;
-            (*mCallback)(mAuthenticated, mUserData);
+    if (fds[1].revents & POLLIN) {
+        if (read(mEventFd, &value, sizeof(value)) != sizeof(value)) {
+            WLOGTRACE("failed to read hdcp event");
+        }
+    }
+
+    Mutex::Autolock lock(mMutex);
+    if (mExiting) {
+        ILOGTRACE("Hdcp thread is exiting.");
+        return false;
+    }
+
+    if (fds[0].revents & POLLIN) {
+        // timer may have been re-armed or disarmed since it fired
+        if (read(mTimerFd, &value, sizeof(value)) == sizeof(value)) {
+            mStats.wakeups++;
+            onTimer();
         }
     }
-    return ret;
+
+    return true;
+}
+
+void HdcpControl::dump(Dump& d)
+{
+    Mutex::Autolock lock(mMutex);
+
+    d.append("HDCP: %s, %s, retry %d\n",
+             getStateName(mState),
+             mAuthenticated ? "authenticated" : "not authenticated",
+             mAuthRetryCount);
+    d.append("  attempts %d, failures %d, authentications %d, "
+             "link losses %d, resumes %d, wakeups %d\n",
+             mStats.attempts,
+             mStats.failures,
+             mStats.authentications,
+             mStats.linkLosses,
+             mStats.resumes,
+             mStats.wakeups);
+    if (mStats.authentications) {
+        d.append("  time to authenticated (ms): last %lld, min %lld, "
+                 "avg %lld, max %lld\n",
+                 mStats.lastAuthTime / 1000000,
+                 mStats.minAuthTime / 1000000,
+                 mStats.totalAuthTime / mStats.authentications / 1000000,
+                 mStats.maxAuthTime / 1000000);
+    }
 }
 
 } // namespace intel
@@ -16,6 +16,7 @@
 #ifndef HDCP_CONTROL_H
 #define HDCP_CONTROL_H
 
+#include <utils/Timers.h>
 #include <IHdcpControl.h>
 #include <common/base/SimpleThread.h>
 
@@ -31,6 +32,9 @@ public:
     virtual bool startHdcp();
     virtual bool startHdcpAsync(HdcpStatusCallback cb, void *userData);
     virtual bool stopHdcp();
+    virtual bool suspendHdcp();
+    virtual bool resumeHdcp();
+    virtual void dump(Dump& d);
 
 protected:
     bool enableAuthentication();
@@ -46,10 +50,18 @@ protected:
     bool runHdcp();
     inline void signalCompletion();
 
+private:
+    bool startThread();
+    void stopThread();
+    void setState(int state, int delayMs);
+    void armTimer(int delayMs);
+    void onTimer();
+    void onAuthenticated();
+    void notifyStatus();
+    static const char* getStateName(int state);
+
 private:
     enum {
-        HDCP_INLOOP_RETRY_NUMBER = 1,
-        HDCP_INLOOP_RETRY_DELAY_US = 50000,
         HDCP_VERIFICATION_DELAY_MS = 2000,
         HDCP_ASYNC_START_DELAY_MS = 100,
         HDCP_AUTHENTICATION_SHORT_DELAY_MS = 200,
@@ -64,21 +76,48 @@ private:
         CALLBACK_NOT_AUTHENTICATED,
     };
 
+    // the thread only wakes up on the deadline of the current state
+    // or when an event is posted through mEventFd
+    enum {
+        HDCP_STOPPED = 0,
+        HDCP_AUTHENTICATING,
+        HDCP_AUTHENTICATED,
+        HDCP_SUSPENDED,
+        HDCP_STATE_COUNT,
+    };
+
+    struct HdcpStats {
+        uint32_t attempts;
+        uint32_t failures;
+        uint32_t authentications;
+        uint32_t linkLosses;
+        uint32_t resumes;
+        uint32_t wakeups;
+        nsecs_t lastAuthTime;
+        nsecs_t minAuthTime;
+        nsecs_t maxAuthTime;
+        nsecs_t totalAuthTime;
+    };
+
 protected:
     HdcpStatusCallback mCallback;
     void *mUserData;
     int mCallbackState;
     Mutex mMutex;
-    Condition mStoppedCondition;
     Condition mCompletedCondition;
     bool mWaitForCompletion;
-    bool mStopped;
     bool mAuthenticated;
-    int mActionDelay;  // in milliseconds
     uint32_t mAuthRetryCount;
     bool mEnableAuthenticationLog;
 
 private:
+    int mState;
+    int mTimerFd;
+    int mEventFd;
+    bool mExiting;
+    // when the current authentication round started
+    nsecs_t mAuthStartTime;
+    HdcpStats mStats;
     DECLARE_THREAD(HdcpControlThread, HdcpControl);
 };
 
@@ -15,6 +15,10 @@
 */
 
 #include <math.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <cutils/properties.h>
+#include <sw_sync.h>
 #include <common/utils/HwcTrace.h>
 #include <common/base/Drm.h>
 #include <Hwcomposer.h>
@@ -32,7 +36,22 @@ namespace intel {
 OverlayPlaneBase::OverlayPlaneBase(int index, int disp)
     : DisplayPlane(index, PLANE_OVERLAY, disp),
       mTTMBuffers(),
+      mTTMBufferLRU(),
+      mEvictedTTMBuffers(),
+      mTTMCacheCapacity(OVERLAY_DATA_BUFFER_COUNT),
       mActiveTTMBuffers(),
+      mFlipPacer(),
+      mFlipPacing(false),
+      mPacePending(false),
+      mPaceTimestamp(0),
+      mDeferredFlipExiting(false),
+      mDisplayedBuffer(-1),
+      mVsyncPeriod(us2ns(DEFAULT_VSYNC_PERIOD_US)),
+      mReleaseTimeline(-1),
+      mReleasePoint(0),
+      mSignaledPoint(0),
+      mReleaseFence(-1),
+      mPrescaledFrames(0),
       mCurrent(0),
       mWsbm(0),
       mPipeConfig(0),
@@ -42,6 +61,12 @@ OverlayPlaneBase::OverlayPlaneBase(int index, int disp)
     for (int i = 0; i < OVERLAY_BACK_BUFFER_COUNT; i++) {
         mBackBuffer[i] = 0;
     }
+    memset(&mTTMStats, 0, sizeof(mTTMStats));
+    memset(&mBackBufferStats, 0, sizeof(mBackBufferStats));
+    memset(&mDeferredFlip, 0, sizeof(mDeferredFlip));
+    memset(&mRelease, 0, sizeof(mRelease));
+    invalidateBackBufferStates();
+    invalidatePayload();
 }
 
 OverlayPlaneBase::~OverlayPlaneBase()
@@ -64,7 +89,18 @@ bool OverlayPlaneBase::initialize(uint32_t bufferCount)
         DEINIT_AND_RETURN_FALSE("failed to initialize display plane");
     }
 
-    mTTMBuffers.setCapacity(bufferCount);
+    mTTMCacheCapacity = bufferCount;
+
+    char prop[PROPERTY_VALUE_MAX];
+    property_get("debug.hwc.video_pacing", prop, "0");
+    mFlipPacing = atoi(prop) != 0;
+    if (mFlipPacing && !createReleaseTimeline()) {
+        WLOGTRACE("no sw_sync timeline, video pacing disabled");
+        mFlipPacing = false;
+    }
+    mTTMBuffers.setCapacity(MAX_TTM_BUFFER_COUNT);
+    mTTMBufferLRU.setCapacity(MAX_TTM_BUFFER_COUNT);
+    mEvictedTTMBuffers.setCapacity(EVICTED_TTM_HISTORY_COUNT);
     mActiveTTMBuffers.setCapacity(MIN_DATA_BUFFER_COUNT);
 
     // init wsbm
@@ -82,10 +118,23 @@ bool OverlayPlaneBase::initialize(uint32_t bufferCount)
         // reset back buffer
         resetBackBuffer(i);
     }
+    invalidateBackBufferStates();
 
     // disable overlay when created
     flush(PLANE_DISABLE);
 
+    if (mFlipPacing) {
+        mDeferredFlipExiting = false;
+        mThread = new DeferredFlipThread(this);
+        if (!mThread.get()) {
+            DEINIT_AND_RETURN_FALSE("failed to create deferred flip thread");
+        }
+        if (mThread->run("DeferredFlip", PRIORITY_URGENT_DISPLAY) != NO_ERROR) {
+            mThread = NULL;
+            DEINIT_AND_RETURN_FALSE("failed to start deferred flip thread");
+        }
+    }
+
     return true;
 }
 
@@ -119,6 +168,18 @@ bool OverlayPlaneBase::isDisabled()
 
 void OverlayPlaneBase::deinitialize()
 {
+    if (mThread.get()) {
+        {
+            Mutex::Autolock _l(mDeferredFlipLock);
+            mDeferredFlipExiting = true;
+            mDeferredFlip.pending = false;
+            mDeferredFlipCond.signal();
+        }
+        mThread->requestExitAndWait();
+        mThread = NULL;
+    }
+    destroyReleaseTimeline();
+
     if (mTTMBuffers.size()) {
         invalidateBufferCache();
     }
@@ -225,6 +286,14 @@ bool OverlayPlaneBase::reset()
     for (int i = 0; i < OVERLAY_BACK_BUFFER_COUNT; i++) {
         resetBackBuffer(i);
     }
+    invalidateBackBufferStates();
+    invalidatePayload();
+    cancelDeferredFlip();
+    {
+        Mutex::Autolock _l(mDeferredFlipLock);
+        mFlipPacer.reset();
+    }
+    mPacePending = false;
     return true;
 }
 
@@ -261,6 +330,9 @@ bool OverlayPlaneBase::disable()
         backBuffer->OCMD &= ~0x1;
     }
 
+    // reprogram everything once enabled again
+    invalidateBackBufferStates();
+
     // flush
     flush(PLANE_DISABLE);
     return true;
@@ -338,7 +410,7 @@ void OverlayPlaneBase::resetBackBuffer(int buf)
     backBuffer->SCHRKEN |= 0xff;
 }
 
-BufferMapper* OverlayPlaneBase::getTTMMapper(BufferMapper& grallocMapper, struct VideoPayloadBuffer *payload)
+BufferMapper* OverlayPlaneBase::getTTMMapper(BufferMapper& grallocMapper, const VideoPayloadSnapshot& payload)
 {
     uint32_t khandle;
     uint32_t w, h;
@@ -347,15 +419,8 @@ BufferMapper* OverlayPlaneBase::getTTMMapper(BufferMapper& grallocMapper, struct
     int srcX, srcY, srcW, srcH;
     int tmp;
 
-    DataBuffer *buf;
     ssize_t index;
-    TTMBufferMapper *mapper;
-    bool ret;
-
-    if (!payload) {
-        ELOGTRACE("invalid payload buffer");
-        return 0;
-    }
+    BufferMapper *mapper;
 
     srcX = grallocMapper.getCrop().x;
     srcY = grallocMapper.getCrop().y;
@@ -363,18 +428,17 @@ BufferMapper* OverlayPlaneBase::getTTMMapper(BufferMapper& grallocMapper, struct
     srcH = grallocMapper.getCrop().h;
 
     // init ttm buffer
-    khandle = payload->rotated_buffer_handle;
+    khandle = payload.rotated_buffer_handle;
     index = mTTMBuffers.indexOfKey(khandle);
     if (index < 0) {
         VLOGTRACE("unmapped TTM buffer, will map it");
-
-        w = payload->rotated_width;
-        h = payload->rotated_height;
-        checkCrop(srcX, srcY, srcW, srcH, payload->coded_width, payload->coded_height);
+        w = payload.rotated_width;
+        h = payload.rotated_height;
+        checkCrop(srcX, srcY, srcW, srcH, payload.coded_width, payload.coded_height);
 
         uint32_t format = grallocMapper.getFormat();
         // this is for sw decode with tiled buffer in landscape mode
-        if (payload->tiling)
+        if (payload.tiling)
             format = OMX_INTEL_COLOR_FormatYUV420PackedSemiPlanar_Tiled;
 
         // calculate stride
@@ -425,62 +489,160 @@ BufferMapper* OverlayPlaneBase::getTTMMapper(BufferMapper& grallocMapper, struct
         buf.setCrop(srcX, srcY, srcW, srcH);
         buf.setFormat(format);
 
-        // create buffer mapper
-        bool res = false;
-        do {
-            mapper = new TTMBufferMapper(*mWsbm, buf);
-            if (!mapper) {
-                ELOGTRACE("failed to allocate mapper");
-                break;
-            }
-            // map ttm buffer
-            ret = mapper->map();
-            if (!ret) {
-                ELOGTRACE("failed to map");
-                invalidateTTMBuffers();
-                ret = mapper->map();
-                if (!ret) {
-                    ELOGTRACE("failed to remap");
-                    break;
-                }
-            }
+        mapper = mapTTMBuffer(buf);
+        if (!mapper) {
+            return 0;
+        }
+    } else {
+        VLOGTRACE("got mapper in saved ttm buffers");
+        mTTMStats.hits++;
+        touchTTMBuffer(khandle);
+        mapper = mTTMBuffers.valueAt(index);
+        if (mapper->getCrop().x != srcX || mapper->getCrop().y != srcY ||
+            mapper->getCrop().w != srcW || mapper->getCrop().h != srcH) {
+            checkCrop(srcX, srcY, srcW, srcH, payload.coded_width, payload.coded_height);
+            mapper->setCrop(srcX, srcY, srcW, srcH);
+        }
+    }
 
-            if (mTTMBuffers.size() >= OVERLAY_DATA_BUFFER_COUNT) {
-                invalidateTTMBuffers();
-            }
+    XLOGTRACE();
+    return mapper;
+}
 
-            // add mapper
-            index = mTTMBuffers.add(khandle, mapper);
-            if (index < 0) {
-                ELOGTRACE("failed to add TTMMapper");
-                break;
-            }
+BufferMapper* OverlayPlaneBase::getScaledTTMMapper(BufferMapper& grallocMapper, const VideoPayloadSnapshot& payload)
+{
+    uint32_t khandle;
+    uint32_t w, h;
+    uint32_t srcWidth, srcHeight;
+    stride_t stride;
+    int srcX, srcY, srcW, srcH;
 
-            // increase mapper refCount since it is added to mTTMBuffers
-            mapper->incRef();
-            res = true;
-        } while (0);
-
-        if (!res) {
-            // error handling
-            if (mapper) {
-                mapper->unmap();
-                delete mapper;
-                mapper = NULL;
-            }
+    ssize_t index;
+    BufferMapper *mapper;
+
+    // the decoder scales the whole coded frame, map the crop into it
+    srcWidth = payload.coded_width ? payload.coded_width : grallocMapper.getWidth();
+    srcHeight = payload.coded_height ? payload.coded_height : grallocMapper.getHeight();
+    w = payload.scaling_width;
+    h = payload.scaling_height;
+    if (!srcWidth || !srcHeight || !w || !h) {
+        return 0;
+    }
+
+    srcX = (uint64_t)grallocMapper.getCrop().x * w / srcWidth;
+    srcY = (uint64_t)grallocMapper.getCrop().y * h / srcHeight;
+    srcW = (uint64_t)grallocMapper.getCrop().w * w / srcWidth;
+    srcH = (uint64_t)grallocMapper.getCrop().h * h / srcHeight;
+    // keep the crop on chroma sample boundaries
+    srcX &= ~1;
+    srcY &= ~1;
+
+    khandle = payload.scaling_khandle;
+    index = mTTMBuffers.indexOfKey(khandle);
+    if (index < 0) {
+        VLOGTRACE("unmapped scaled TTM buffer, will map it");
+
+        // scaled buffers are always linear NV12
+        stride.yuv.yStride = payload.scaling_luma_stride ?
+            payload.scaling_luma_stride : align_to(align_to(w, 32), 64);
+        stride.yuv.uvStride = payload.scaling_chroma_u_stride ?
+            payload.scaling_chroma_u_stride : stride.yuv.yStride;
+
+        DataBuffer buf(khandle);
+        buf.setStride(stride);
+        buf.setWidth(w);
+        buf.setHeight(h);
+        buf.setCrop(srcX, srcY, srcW, srcH);
+        buf.setFormat(OMX_INTEL_COLOR_FormatYUV420PackedSemiPlanar);
+
+        mapper = mapTTMBuffer(buf);
+        if (!mapper) {
             return 0;
         }
     } else {
         VLOGTRACE("got mapper in saved ttm buffers");
-        mapper = reinterpret_cast<TTMBufferMapper *>(mTTMBuffers.valueAt(index));
+        mTTMStats.hits++;
+        touchTTMBuffer(khandle);
+        mapper = mTTMBuffers.valueAt(index);
         if (mapper->getCrop().x != srcX || mapper->getCrop().y != srcY ||
             mapper->getCrop().w != srcW || mapper->getCrop().h != srcH) {
-            checkCrop(srcX, srcY, srcW, srcH, payload->coded_width, payload->coded_height);
             mapper->setCrop(srcX, srcY, srcW, srcH);
         }
     }
 
-    XLOGTRACE();
+    return mapper;
+}
+
+BufferMapper* OverlayPlaneBase::mapTTMBuffer(DataBuffer& buf)
+{
+    uint64_t key = buf.getKey();
+    TTMBufferMapper *mapper = 0;
+    ssize_t index;
+    bool ret;
+
+    mTTMStats.misses++;
+
+    // evicted recently, the decoder pool doesn't fit in the cache
+    for (size_t i = 0; i < mEvictedTTMBuffers.size(); i++) {
+        if (mEvictedTTMBuffers.itemAt(i) != key) {
+            continue;
+        }
+        mEvictedTTMBuffers.removeAt(i);
+        if (mTTMCacheCapacity < MAX_TTM_BUFFER_COUNT) {
+            mTTMCacheCapacity++;
+            DLOGTRACE("TTM cache capacity grows to %d", mTTMCacheCapacity);
+        }
+        break;
+    }
+
+    // create buffer mapper
+    bool res = false;
+    do {
+        mapper = new TTMBufferMapper(*mWsbm, buf);
+        if (!mapper) {
+            ELOGTRACE("failed to allocate mapper");
+            break;
+        }
+        // map ttm buffer
+        ret = mapper->map();
+        if (!ret) {
+            ELOGTRACE("failed to map");
+            invalidateTTMBuffers();
+            ret = mapper->map();
+            if (!ret) {
+                ELOGTRACE("failed to remap");
+                break;
+            }
+        }
+
+        while ((int)mTTMBuffers.size() >= mTTMCacheCapacity) {
+            if (!evictTTMBuffer()) {
+                break;
+            }
+        }
+
+        // add mapper
+        index = mTTMBuffers.add(key, mapper);
+        if (index < 0) {
+            ELOGTRACE("failed to add TTMMapper");
+            break;
+        }
+        mTTMBufferLRU.push_back(key);
+
+        // increase mapper refCount since it is added to mTTMBuffers
+        mapper->incRef();
+        res = true;
+    } while (0);
+
+    if (!res) {
+        // error handling
+        if (mapper) {
+            mapper->unmap();
+            delete mapper;
+            mapper = NULL;
+        }
+        return 0;
+    }
     return mapper;
 }
 
@@ -551,7 +713,386 @@ void OverlayPlaneBase::invalidateTTMBuffers()
         // putTTMMapper removes mapper from cache
         putTTMMapper(mapper);
     }
+    if (mTTMBuffers.size()) {
+        mTTMStats.flushes++;
+    }
     mTTMBuffers.clear();
+    mTTMBufferLRU.clear();
+    mEvictedTTMBuffers.clear();
+}
+
+void OverlayPlaneBase::touchTTMBuffer(uint64_t key)
+{
+    size_t count = mTTMBufferLRU.size();
+    if (count && mTTMBufferLRU.itemAt(count - 1) == key) {
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (mTTMBufferLRU.itemAt(i) == key) {
+            mTTMBufferLRU.removeAt(i);
+            break;
+        }
+    }
+    mTTMBufferLRU.push_back(key);
+}
+
+bool OverlayPlaneBase::evictTTMBuffer()
+{
+    // evict the least recently used buffer that is not on screen
+    for (size_t i = 0; i < mTTMBufferLRU.size(); i++) {
+        uint64_t key = mTTMBufferLRU.itemAt(i);
+        ssize_t index = mTTMBuffers.indexOfKey(key);
+        if (index < 0) {
+            ELOGTRACE("TTM buffer %#llx is not cached", key);
+            mTTMBufferLRU.removeAt(i);
+            return true;
+        }
+
+        BufferMapper *mapper = mTTMBuffers.valueAt(index);
+        if (isActiveTTMBuffer(mapper)) {
+            continue;
+        }
+
+        VLOGTRACE("evicting TTM buffer %#llx", key);
+        putTTMMapper(mapper);
+        mTTMBuffers.removeItemsAt(index);
+        mTTMBufferLRU.removeAt(i);
+
+        if (mEvictedTTMBuffers.size() >= EVICTED_TTM_HISTORY_COUNT) {
+            mEvictedTTMBuffers.removeAt(0);
+        }
+        mEvictedTTMBuffers.push_back(key);
+        mTTMStats.evictions++;
+        return true;
+    }
+
+    WLOGTRACE("all TTM buffers are active");
+    return false;
+}
+
+VideoPayloadBuffer* OverlayPlaneBase::readPayload(BufferMapper& mapper, bool refresh)
+{
+    if (!refresh && mPayloadBuffer && mPayloadKey == mapper.getKey()) {
+        return mPayloadBuffer;
+    }
+
+    invalidatePayload();
+
+    VideoPayloadBuffer *payload =
+        (VideoPayloadBuffer *)mapper.getCpuAddress(SUB_BUFFER1);
+    if (!payload) {
+        return NULL;
+    }
+
+    // the decoder updates the payload without any lock, copy it again
+    // if the fields it writes together changed while copying
+    const volatile VideoPayloadBuffer *p = payload;
+    for (int i = 0; i < PAYLOAD_SNAPSHOT_RETRIES; i++) {
+        mPayload.client_transform = p->client_transform;
+        mPayload.rotated_width = p->rotated_width;
+        mPayload.rotated_height = p->rotated_height;
+        mPayload.surface_protected = p->surface_protected;
+        mPayload.force_output_method = p->force_output_method;
+        mPayload.rotated_buffer_handle = p->rotated_buffer_handle;
+        mPayload.bob_deinterlace = p->bob_deinterlace;
+        mPayload.tiling = p->tiling;
+        mPayload.khandle = p->khandle;
+        mPayload.timestamp = p->timestamp;
+        mPayload.scaling_khandle = p->scaling_khandle;
+        mPayload.scaling_width = p->scaling_width;
+        mPayload.scaling_height = p->scaling_height;
+        mPayload.scaling_luma_stride = p->scaling_luma_stride;
+        mPayload.scaling_chroma_u_stride = p->scaling_chroma_u_stride;
+        mPayload.crop_width = p->crop_width;
+        mPayload.crop_height = p->crop_height;
+        mPayload.coded_width = p->coded_width;
+        mPayload.coded_height = p->coded_height;
+        __sync_synchronize();
+
+        if (p->timestamp == mPayload.timestamp &&
+            p->client_transform == mPayload.client_transform &&
+            p->rotated_buffer_handle == mPayload.rotated_buffer_handle &&
+            p->scaling_khandle == mPayload.scaling_khandle) {
+            break;
+        }
+        VLOGTRACE("payload changed while reading it, retry");
+    }
+
+    mPayloadBuffer = payload;
+    mPayloadKey = mapper.getKey();
+    return payload;
+}
+
+void OverlayPlaneBase::invalidatePayload()
+{
+    memset(&mPayload, 0, sizeof(mPayload));
+    mPayloadBuffer = NULL;
+    mPayloadKey = 0;
+}
+
+bool OverlayPlaneBase::deferFlip(uint32_t& ovadd, int& displayedBuffer)
+{
+    Mutex::Autolock _l(mDeferredFlipLock);
+
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    // frames flipped before this one are released through points up to
+    // this one, a frame is only held on screen past a commit when its
+    // release fence has a point
+    uint32_t previous = mReleasePoint;
+    bool fenced = false;
+    if (mReleaseTimeline != -1) {
+        if (mReleaseFence != -1) {
+            close(mReleaseFence);
+        }
+        mReleaseFence = sw_sync_fence_create(mReleaseTimeline,
+                                             "hwc_overlay", ++mReleasePoint);
+        if (mReleaseFence < 0) {
+            ELOGTRACE("failed to create release fence");
+            mReleaseFence = -1;
+        } else {
+            fenced = true;
+        }
+    }
+
+    // a frame still waiting for its vsync is replaced by this one, which
+    // is then flipped right away so a commit never writes into the back
+    // buffer on screen
+    bool replaced = mDeferredFlip.pending;
+    if (replaced) {
+        mDeferredFlip.pending = false;
+        if (!mDeferredFlip.failed) {
+            mFlipPacer.onCancel();
+        }
+        // coefficients of the replaced frame were never loaded
+        ovadd |= (mDeferredFlip.ovadd & 0x1);
+    }
+
+    nsecs_t hold = 0;
+    if (mPacePending) {
+        mPacePending = false;
+        nsecs_t period, lastVsync;
+        IDisplayDevice *device = Hwcomposer::getInstance().getDisplayDevice(mDevice);
+        if (device && mDevice <= IDisplayDevice::DEVICE_EXTERNAL &&
+            static_cast<PhysicalDevice*>(device)->getVsyncModel(period, lastVsync)) {
+            mVsyncPeriod = period;
+            hold = mFlipPacer.schedule(mPaceTimestamp, now, period, lastVsync);
+        }
+    }
+
+    if (hold <= 0 || replaced || mDisplayedBuffer < 0 ||
+        !fenced || !mThread.get()) {
+        mFlipPacer.onFlip(now);
+        mDisplayedBuffer = fenced ? mCurrent : -1;
+        if (mReleaseTimeline != -1) {
+            // the kernel release fence of the frame on screen covers its
+            // replacement by this commit, frames before a replaced flip
+            // are on screen until the vsync after this commit
+            releaseFrames(previous, replaced ?
+                          now + mVsyncPeriod + us2ns(RELEASE_MARGIN_US) : 0);
+        }
+        return false;
+    }
+
+    // the displayed frame is posted again by this commit, its release
+    // point is only signaled after the deferred flip replaced it
+    mDeferredFlip.pending = true;
+    mDeferredFlip.failed = false;
+    mDeferredFlip.ovadd = ovadd;
+    mDeferredFlip.time = now + hold;
+    mDeferredFlip.buffer = mCurrent;
+    mDeferredFlipCond.signal();
+
+    displayedBuffer = mDisplayedBuffer;
+    return true;
+}
+
+void OverlayPlaneBase::cancelDeferredFlip()
+{
+    Mutex::Autolock _l(mDeferredFlipLock);
+    if (mDeferredFlip.pending) {
+        mDeferredFlip.pending = false;
+        if (!mDeferredFlip.failed) {
+            mFlipPacer.onCancel();
+        }
+        if (mDeferredFlip.ovadd & 0x1) {
+            mCoeffLoaded = false;
+        }
+    }
+    mDisplayedBuffer = -1;
+
+    // nothing flipped so far is on screen after the next vsync
+    if (mReleaseTimeline != -1) {
+        releaseFrames(mReleasePoint, systemTime(SYSTEM_TIME_MONOTONIC) +
+                      mVsyncPeriod + us2ns(RELEASE_MARGIN_US));
+    }
+}
+
+int OverlayPlaneBase::getReleaseFence()
+{
+    Mutex::Autolock _l(mDeferredFlipLock);
+    int fence = mReleaseFence;
+    mReleaseFence = -1;
+    return fence;
+}
+
+bool OverlayPlaneBase::createReleaseTimeline()
+{
+    mReleaseTimeline = sw_sync_timeline_create();
+    if (mReleaseTimeline < 0) {
+        mReleaseTimeline = -1;
+        return false;
+    }
+    mReleasePoint = 0;
+    mSignaledPoint = 0;
+    memset(&mRelease, 0, sizeof(mRelease));
+    return true;
+}
+
+void OverlayPlaneBase::destroyReleaseTimeline()
+{
+    if (mReleaseFence != -1) {
+        close(mReleaseFence);
+        mReleaseFence = -1;
+    }
+    if (mReleaseTimeline != -1) {
+        signalReleasePoint(mReleasePoint);
+        close(mReleaseTimeline);
+        mReleaseTimeline = -1;
+    }
+    mRelease.pending = false;
+}
+
+// called with mDeferredFlipLock held, frames up to the point are released
+// once time is reached, right away if it already is
+void OverlayPlaneBase::releaseFrames(uint32_t point, nsecs_t time)
+{
+    if (!mRelease.pending) {
+        if (time <= systemTime(SYSTEM_TIME_MONOTONIC)) {
+            signalReleasePoint(point);
+            return;
+        }
+        mRelease.pending = true;
+        mRelease.point = point;
+        mRelease.time = time;
+    } else {
+        // points are released in order, so a later one waits as long as
+        // the ones already pending
+        if ((int32_t)(point - mRelease.point) > 0) {
+            mRelease.point = point;
+        }
+        if (time > mRelease.time) {
+            mRelease.time = time;
+        }
+    }
+    mDeferredFlipCond.signal();
+}
+
+void OverlayPlaneBase::signalReleasePoint(uint32_t point)
+{
+    if ((int32_t)(point - mSignaledPoint) <= 0) {
+        return;
+    }
+    if (sw_sync_timeline_inc(mReleaseTimeline, point - mSignaledPoint) < 0) {
+        ELOGTRACE("failed to signal release point %u", point);
+    }
+    mSignaledPoint = point;
+}
+
+bool OverlayPlaneBase::threadLoop()
+{
+    Mutex::Autolock _l(mDeferredFlipLock);
+    while (!mDeferredFlipExiting && !mRelease.pending &&
+           (!mDeferredFlip.pending || mDeferredFlip.failed)) {
+        mDeferredFlipCond.wait(mDeferredFlipLock);
+    }
+    if (mDeferredFlipExiting) {
+        return false;
+    }
+
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    if (mRelease.pending && now >= mRelease.time) {
+        mRelease.pending = false;
+        signalReleasePoint(mRelease.point);
+    }
+
+    bool flipping = mDeferredFlip.pending && !mDeferredFlip.failed;
+    if (flipping && now >= mDeferredFlip.time) {
+        flipping = false;
+        if (updateOverlayAddress(mDeferredFlip.ovadd)) {
+            mDeferredFlip.pending = false;
+            mDisplayedBuffer = mDeferredFlip.buffer;
+            mFlipPacer.onFlip(now);
+            // frames before the deferred one leave the screen on the
+            // vsync latching it
+            releaseFrames(mReleasePoint - 1,
+                          now + mVsyncPeriod + us2ns(RELEASE_MARGIN_US));
+        } else {
+            WLOGTRACE("failed to flip deferred video frame");
+            mDeferredFlip.failed = true;
+            mFlipPacer.onCancel();
+        }
+    }
+
+    // woken up early when a flip or release is added, replaced or cancelled
+    nsecs_t wake = 0;
+    if (mRelease.pending) {
+        wake = mRelease.time;
+    }
+    if (flipping && (!wake || mDeferredFlip.time < wake)) {
+        wake = mDeferredFlip.time;
+    }
+    if (wake > now) {
+        mDeferredFlipCond.waitRelative(mDeferredFlipLock, wake - now);
+    }
+    return true;
+}
+
+void OverlayPlaneBase::invalidateBackBufferStates()
+{
+    memset(mBackBufferState, 0, sizeof(mBackBufferState));
+    memset(mLoadedScale, 0, sizeof(mLoadedScale));
+    mCoeffLoaded = false;
+}
+
+bool OverlayPlaneBase::isCoeffLoadNeeded()
+{
+    const OverlayBackBufferState& state = mBackBufferState[mCurrent];
+
+    if (mCoeffLoaded && state.valid &&
+        !memcmp(mLoadedScale, state.scale, sizeof(mLoadedScale))) {
+        return false;
+    }
+
+    memcpy(mLoadedScale, state.scale, sizeof(mLoadedScale));
+    mCoeffLoaded = state.valid;
+    mBackBufferStats.coeffLoads++;
+    return true;
+}
+
+void OverlayPlaneBase::dump(Dump& d)
+{
+    d.append("Overlay %d TTM cache: %d/%d, hits %u, misses %u, evictions %u, flushes %u\n",
+             mIndex,
+             mTTMBuffers.size(),
+             mTTMCacheCapacity,
+             mTTMStats.hits,
+             mTTMStats.misses,
+             mTTMStats.evictions,
+             mTTMStats.flushes);
+    d.append("Overlay %d back buffer: full updates %u, address updates %u, coefficient loads %u\n",
+             mIndex,
+             mBackBufferStats.fullUpdates,
+             mBackBufferStats.addressUpdates,
+             mBackBufferStats.coeffLoads);
+    d.append("Overlay %d pre-scaled frames: %u\n", mIndex, mPrescaledFrames);
+    if (mFlipPacing) {
+        Mutex::Autolock _l(mDeferredFlipLock);
+        mFlipPacer.dump(d, mIndex);
+        d.append("Overlay %d release point: %u, signaled %u\n",
+                 mIndex, mReleasePoint, mSignaledPoint);
+    }
 }
 
 
@@ -566,18 +1107,18 @@ bool OverlayPlaneBase::rotatedBufferReady(BufferMapper& mapper, BufferMapper* &r
         format != OMX_INTEL_COLOR_FormatYUV420PackedSemiPlanar_Tiled)
         return false;
 
-    payload = (struct VideoPayloadBuffer *)mapper.getCpuAddress(SUB_BUFFER1);
+    payload = readPayload(mapper);
     // check payload
     if (!payload) {
         ELOGTRACE("no payload found");
         return false;
     }
 
-    if (payload->force_output_method == FORCE_OUTPUT_GPU)
+    if (mPayload.force_output_method == FORCE_OUTPUT_GPU)
         return false;
 
-    if (payload->client_transform != mTransform) {
-        if (payload->surface_protected) {
+    if (mPayload.client_transform != mTransform) {
+        if (mPayload.surface_protected) {
             payload->hwc_timestamp = systemTime();
             payload->layer_transform = mTransform;
         }
@@ -585,11 +1126,93 @@ bool OverlayPlaneBase::rotatedBufferReady(BufferMapper& mapper, BufferMapper* &r
         return false;
     }
 
-    rotatedMapper = getTTMMapper(mapper, payload);
+    rotatedMapper = getTTMMapper(mapper, mPayload);
     return true;
 }
 
 
+bool OverlayPlaneBase::isScaledBufferUsable(BufferMapper& mapper)
+{
+    uint32_t format;
+
+    // rotated buffers are not scaled by the decoder
+    if (mTransform) {
+        return false;
+    }
+
+    // only NV12_VED has scaled buffer
+    format = mapper.getFormat();
+    if (format != OMX_INTEL_COLOR_FormatYUV420PackedSemiPlanar &&
+        format != OMX_INTEL_COLOR_FormatYUV420PackedSemiPlanar_Tiled)
+        return false;
+
+    if (!readPayload(mapper)) {
+        return false;
+    }
+
+    if (!mPayload.scaling_khandle ||
+        !mPayload.scaling_width || !mPayload.scaling_height) {
+        return false;
+    }
+
+    int dstW = mPosition.w;
+    int dstH = mPosition.h;
+    int srcW = mapper.getCrop().w;
+    int srcH = mapper.getCrop().h;
+    if (dstW <= 0 || dstH <= 0 || srcW <= 0 || srcH <= 0) {
+        return false;
+    }
+
+    // not worth the extra surface for a moderate downscale
+    if (srcW <= PRESCALE_MIN_RATIO * dstW && srcH <= PRESCALE_MIN_RATIO * dstH) {
+        return false;
+    }
+
+    uint32_t srcWidth = mPayload.coded_width ? mPayload.coded_width : mapper.getWidth();
+    uint32_t srcHeight = mPayload.coded_height ? mPayload.coded_height : mapper.getHeight();
+    if (!srcWidth || !srcHeight) {
+        return false;
+    }
+    int scaledW = (uint64_t)srcW * mPayload.scaling_width / srcWidth;
+    int scaledH = (uint64_t)srcH * mPayload.scaling_height / srcHeight;
+
+    // the overlay still has to fit the scaled surface to the output
+    if (scaledW > MAX_OVERLAY_DOWNSCALE * dstW ||
+        scaledH > MAX_OVERLAY_DOWNSCALE * dstH) {
+        return false;
+    }
+
+    // within the overlay limits, don't trade detail for bandwidth
+    if (srcW <= MAX_OVERLAY_DOWNSCALE * dstW &&
+        srcH <= MAX_OVERLAY_DOWNSCALE * dstH &&
+        (scaledW < dstW || scaledH < dstH)) {
+        return false;
+    }
+
+    return true;
+}
+
+bool OverlayPlaneBase::scaledBufferReady(BufferMapper& mapper, BufferMapper* &scaledMapper)
+{
+    if (!isScaledBufferUsable(mapper)) {
+        return false;
+    }
+
+    scaledMapper = getScaledTTMMapper(mapper, mPayload);
+    if (!scaledMapper) {
+        WLOGTRACE("failed to map scaled buffer");
+        return false;
+    }
+
+    mPrescaledFrames++;
+    return true;
+}
+
+void OverlayPlaneBase::checkDownscale(BufferMapper& /* mapper */)
+{
+    // by default the overlay scaler limits are left to scalingSetup
+}
+
 bool OverlayPlaneBase::useOverlayRotation(BufferMapper& /* mapper */)
 {
     // by default overlay plane does not support rotation.
@@ -1119,6 +1742,7 @@ bool OverlayPlaneBase::setDataBuffer(BufferMapper& grallocMapper)
 {
     BufferMapper *mapper;
     BufferMapper *rotatedMapper = 0;
+    BufferMapper *scaledMapper = 0;
     bool ret;
     uint32_t format;
 
@@ -1129,14 +1753,27 @@ bool OverlayPlaneBase::setDataBuffer(BufferMapper& grallocMapper)
     format = grallocMapper.getFormat();
     if (format == OMX_INTEL_COLOR_FormatYUV420PackedSemiPlanar ||
         format == OMX_INTEL_COLOR_FormatYUV420PackedSemiPlanar_Tiled) {
-        struct VideoPayloadBuffer *payload;
-        payload = (struct VideoPayloadBuffer *)grallocMapper.getCpuAddress(SUB_BUFFER1);
-        if (!payload) {
+        // snapshot the payload once for this frame
+        if (!readPayload(grallocMapper, true)) {
             ELOGTRACE("invalid payload buffer");
             return 0;
         }
 
-        mBobDeinterlace = payload->bob_deinterlace;
+        mBobDeinterlace = mPayload.bob_deinterlace;
+
+        // feed video cadence to the refresh rate governor
+        Hwcomposer::getInstance().getDisplayAnalyzer()->postVideoFrame(
+            mDevice, mPayload.timestamp);
+
+        if (mFlipPacing && mPayload.timestamp != mPaceTimestamp) {
+            mPaceTimestamp = mPayload.timestamp;
+            mPacePending = true;
+        }
+    }
+
+    // decoder downscaled surface, less to fetch and within overlay limits
+    if (!scaledBufferReady(grallocMapper, scaledMapper)) {
+        checkDownscale(grallocMapper);
     }
 
     if (mTransform && !useOverlayRotation(grallocMapper)) {
@@ -1150,6 +1787,8 @@ bool OverlayPlaneBase::setDataBuffer(BufferMapper& grallocMapper)
             return false;
         }
         mapper = rotatedMapper;
+    } else if (scaledMapper) {
+        mapper = scaledMapper;
     }
 
     OverlayBackBufferBlk *backBuffer = mBackBuffer[mCurrent]->buf;
@@ -1158,36 +1797,106 @@ bool OverlayPlaneBase::setDataBuffer(BufferMapper& grallocMapper)
         return false;
     }
 
-    ret = bufferOffsetSetup(*mapper);
-    if (ret == false) {
-        ELOGTRACE("failed to set up buffer offsets");
-        return false;
-    }
+    // compare with what this back buffer was last programmed with,
+    // usually only the buffer address changes during video playback
+    OverlayBackBufferState& state = mBackBufferState[mCurrent];
+    uint32_t gttOffsetInPage = mapper->getGttOffsetInPage(0);
+
+    bool layoutChanged = !state.valid ||
+        state.format != mapper->getFormat() ||
+        state.width != mapper->getWidth() ||
+        state.height != mapper->getHeight() ||
+        memcmp(&state.stride, &mapper->getStride(), sizeof(stride_t)) ||
+        memcmp(&state.crop, &mapper->getCrop(), sizeof(crop_t)) ||
+        state.isProtected != mIsProtectedBuffer ||
+        state.bobDeinterlace != mBobDeinterlace;
+
+    bool scalingChanged = layoutChanged ||
+        memcmp(&state.position, &mPosition, sizeof(PlanePosition)) ||
+        state.transform != mTransform ||
+        state.hdisplay != mModeInfo.hdisplay ||
+        state.vdisplay != mModeInfo.vdisplay ||
+        state.panelOrientation != mPanelOrientation;
+
+    state.valid = false;
+
+    if (layoutChanged) {
+        ret = bufferOffsetSetup(*mapper);
+        if (ret == false) {
+            ELOGTRACE("failed to set up buffer offsets");
+            return false;
+        }
 
-    ret = coordinateSetup(*mapper);
-    if (ret == false) {
-        ELOGTRACE("failed to set up overlay coordinates");
-        return false;
-    }
+        ret = coordinateSetup(*mapper);
+        if (ret == false) {
+            ELOGTRACE("failed to set up overlay coordinates");
+            return false;
+        }
 
-    ret = scalingSetup(*mapper);
-    if (ret == false) {
-        ELOGTRACE("failed to set up scaling parameters");
-        return false;
+        backBuffer->OCMD |= 0x1;
+
+        if (mBobDeinterlace && !mTransform) {
+            backBuffer->OCMD |= BUF_TYPE_FIELD;
+            backBuffer->OCMD &= ~FIELD_SELECT;
+            backBuffer->OCMD |= FIELD0;
+            backBuffer->OCMD &= ~(BUFFER_SELECT);
+            backBuffer->OCMD |= BUFFER0;
+        }
+
+        state.ostart[0] = backBuffer->OSTART_0Y;
+        state.ostart[1] = backBuffer->OSTART_0U;
+        state.ostart[2] = backBuffer->OSTART_0V;
+        state.ostart[3] = backBuffer->OSTART_1Y;
+        state.ostart[4] = backBuffer->OSTART_1U;
+        state.ostart[5] = backBuffer->OSTART_1V;
+        mBackBufferStats.fullUpdates++;
+    } else if (state.gttOffsetInPage != gttOffsetInPage) {
+        // same layout in another buffer, only move the surface addresses,
+        // registers left unprogrammed by bufferOffsetSetup stay cleared
+        uint32_t delta = (gttOffsetInPage - state.gttOffsetInPage) << 12;
+        for (int i = 0; i < OVERLAY_SURFACE_ADDRESS_COUNT; i++) {
+            if (state.ostart[i]) {
+                state.ostart[i] += delta;
+            }
+        }
+        backBuffer->OSTART_0Y = state.ostart[0];
+        backBuffer->OSTART_0U = state.ostart[1];
+        backBuffer->OSTART_0V = state.ostart[2];
+        backBuffer->OSTART_1Y = state.ostart[3];
+        backBuffer->OSTART_1U = state.ostart[4];
+        backBuffer->OSTART_1V = state.ostart[5];
+        mBackBufferStats.addressUpdates++;
     }
 
-    backBuffer->OCMD |= 0x1;
+    if (scalingChanged) {
+        ret = scalingSetup(*mapper);
+        if (ret == false) {
+            ELOGTRACE("failed to set up scaling parameters");
+            return false;
+        }
 
-    if (mBobDeinterlace && !mTransform) {
-        backBuffer->OCMD |= BUF_TYPE_FIELD;
-        backBuffer->OCMD &= ~FIELD_SELECT;
-        backBuffer->OCMD |= FIELD0;
-        backBuffer->OCMD &= ~(BUFFER_SELECT);
-        backBuffer->OCMD |= BUFFER0;
+        state.scale[0] = backBuffer->YRGBSCALE;
+        state.scale[1] = backBuffer->UVSCALE;
+        state.scale[2] = backBuffer->UVSCALEV;
     }
 
-    // add to active ttm buffers if it's a rotated buffer
-    if (rotatedMapper) {
+    state.format = mapper->getFormat();
+    state.width = mapper->getWidth();
+    state.height = mapper->getHeight();
+    state.stride = mapper->getStride();
+    state.crop = mapper->getCrop();
+    state.isProtected = mIsProtectedBuffer;
+    state.bobDeinterlace = mBobDeinterlace;
+    state.position = mPosition;
+    state.transform = mTransform;
+    state.hdisplay = mModeInfo.hdisplay;
+    state.vdisplay = mModeInfo.vdisplay;
+    state.panelOrientation = mPanelOrientation;
+    state.gttOffsetInPage = gttOffsetInPage;
+    state.valid = true;
+
+    // add to active ttm buffers if it's a rotated or scaled buffer
+    if (rotatedMapper || scaledMapper) {
         updateActiveTTMBuffers(mapper);
     }
 
@@ -17,11 +17,14 @@
 #define OVERLAY_PLANE_BASE_H
 
 #include <utils/KeyedVector.h>
+#include <utils/threads.h>
+#include <common/base/SimpleThread.h>
 #include <DisplayPlane.h>
 #include <BufferMapper.h>
 #include <ips/common/Wsbm.h>
 #include <ips/common/OverlayHardware.h>
 #include <ips/common/VideoPayloadBuffer.h>
+#include <ips/common/VideoFlipPacer.h>
 
 namespace android {
 namespace intel {
@@ -51,9 +54,12 @@ public:
     virtual bool isDisabled();
 
     virtual void* getContext() const = 0;
+    virtual int getReleaseFence();
     virtual bool initialize(uint32_t bufferCount);
     virtual void deinitialize();
 
+    virtual void dump(Dump& d);
+
 protected:
     // generic overlay register flush
     virtual bool flush(uint32_t flags) = 0;
@@ -69,6 +75,9 @@ protected:
     virtual bool scalingSetup(BufferMapper& mapper);
     virtual void checkPosition(int& x, int& y, int& w, int& h);
     virtual void checkCrop(int& x, int& y, int& w, int& h, int coded_width, int coded_height);
+    // brings the source crop within the overlay scaling limits when no
+    // decoder scaled surface is flipped instead
+    virtual void checkDownscale(BufferMapper& mapper);
 
 
 protected:
@@ -77,16 +86,50 @@ protected:
     virtual void deleteBackBuffer(int buf);
     virtual void resetBackBuffer(int buf);
 
-    virtual BufferMapper* getTTMMapper(BufferMapper& grallocMapper, struct VideoPayloadBuffer *payload);
+    virtual BufferMapper* getTTMMapper(BufferMapper& grallocMapper, const VideoPayloadSnapshot& payload);
     virtual void  putTTMMapper(BufferMapper* mapper);
     virtual bool rotatedBufferReady(BufferMapper& mapper, BufferMapper* &rotatedMapper);
     virtual bool useOverlayRotation(BufferMapper& mapper);
+    // maps the surface the decoder downscaled for this frame
+    BufferMapper* getScaledTTMMapper(BufferMapper& grallocMapper, const VideoPayloadSnapshot& payload);
+    // true if the decoder provided a downscaled surface worth flipping
+    // instead of the decoded one for the current crop and position
+    bool isScaledBufferUsable(BufferMapper& mapper);
+    virtual bool scaledBufferReady(BufferMapper& mapper, BufferMapper* &scaledMapper);
 
 private:
     inline bool isActiveTTMBuffer(BufferMapper *mapper);
     void updateActiveTTMBuffers(BufferMapper *mapper);
     void invalidateActiveTTMBuffers();
     void invalidateTTMBuffers();
+    void touchTTMBuffer(uint64_t key);
+    bool evictTTMBuffer();
+    // maps a TTM buffer missing from the cache and adds it
+    BufferMapper* mapTTMBuffer(DataBuffer& buf);
+
+protected:
+    // takes a snapshot of the payload of a video buffer into mPayload,
+    // reused until the buffer changes or refresh is set. Returns the
+    // shared payload which must only be used for writes
+    VideoPayloadBuffer* readPayload(BufferMapper& mapper, bool refresh = false);
+    void invalidatePayload();
+    // hands the flip of a new video frame that is early for its ideal
+    // vsync to the deferred flip thread. Returns true if it was deferred,
+    // displayedBuffer is then the back buffer to keep on screen
+    bool deferFlip(uint32_t& ovadd, int& displayedBuffer);
+    void cancelDeferredFlip();
+    // release fences of paced frames, see getReleaseFence
+    bool createReleaseTimeline();
+    void destroyReleaseTimeline();
+    void releaseFrames(uint32_t point, nsecs_t time);
+    void signalReleasePoint(uint32_t point);
+    // programs the overlay address outside of a commit
+    virtual bool updateOverlayAddress(uint32_t ovadd) = 0;
+
+protected:
+    void invalidateBackBufferStates();
+    // true if coefficients of the current back buffer need to be loaded
+    bool isCoeffLoadNeeded();
 
 protected:
     // flush flags
@@ -100,22 +143,133 @@ protected:
         OVERLAY_BACK_BUFFER_COUNT = 3,
         MAX_ACTIVE_TTM_BUFFERS = 3,
         OVERLAY_DATA_BUFFER_COUNT = 20,
+        // TTM cache grows up to this when the decoder pool is larger
+        MAX_TTM_BUFFER_COUNT = 64,
+        // recently evicted keys remembered to detect a too small cache
+        EVICTED_TTM_HISTORY_COUNT = 16,
+        // attempts to get a payload copy the decoder didn't update midway
+        PAYLOAD_SNAPSHOT_RETRIES = 3,
+        // largest source to destination ratio the overlay scaler handles
+        MAX_OVERLAY_DOWNSCALE = 4,
+        // downscale ratio above which a decoder scaled surface is used
+        PRESCALE_MIN_RATIO = 2,
+        // OSTART registers of both overlay buffers
+        OVERLAY_SURFACE_ADDRESS_COUNT = 6,
+        // assumed until the vsync model of the device is known
+        DEFAULT_VSYNC_PERIOD_US = 16667,
+        // slack after the vsync latching a flip before frames it
+        // replaced are released
+        RELEASE_MARGIN_US = 2000,
     };
 
     // TTM data buffers
     KeyedVector<uint64_t, BufferMapper*> mTTMBuffers;
+    // keys of TTM data buffers, least recently used first
+    Vector<uint64_t> mTTMBufferLRU;
+    // keys of recently evicted TTM data buffers
+    Vector<uint64_t> mEvictedTTMBuffers;
+    int mTTMCacheCapacity;
     // latest TTM buffers
     Vector<BufferMapper*> mActiveTTMBuffers;
 
+    // TTM cache statistics
+    struct {
+        uint32_t hits;
+        uint32_t misses;
+        uint32_t evictions;
+        uint32_t flushes;
+    } mTTMStats;
+
+    // payload snapshot of the current video buffer
+    VideoPayloadSnapshot mPayload;
+    VideoPayloadBuffer *mPayloadBuffer;
+    uint64_t mPayloadKey;
+
+    // video cadence pacing
+    VideoFlipPacer mFlipPacer;
+    bool mFlipPacing;
+    bool mPacePending;
+    int64_t mPaceTimestamp;
+    // flip programmed by the deferred flip thread once its time is reached
+    struct {
+        bool pending;
+        uint32_t ovadd;
+        nsecs_t time;
+        int buffer;
+        // the flip could not be programmed, the frame before it stays on
+        // screen until the next commit
+        bool failed;
+    } mDeferredFlip;
+    // frames up to this release point are released once time is reached
+    struct {
+        bool pending;
+        uint32_t point;
+        nsecs_t time;
+    } mRelease;
+    bool mDeferredFlipExiting;
+    // back buffer on screen, -1 if unknown
+    int mDisplayedBuffer;
+    nsecs_t mVsyncPeriod;
+    // sw_sync timeline, each flip gets the next point on it and its
+    // fence is merged into the release fence of the layer
+    int mReleaseTimeline;
+    uint32_t mReleasePoint;
+    uint32_t mSignaledPoint;
+    int mReleaseFence;
+    Mutex mDeferredFlipLock;
+    Condition mDeferredFlipCond;
+
+    // frames flipped from a decoder scaled surface
+    uint32_t mPrescaledFrames;
+
     // overlay back buffer
     OverlayBackBuffer *mBackBuffer[OVERLAY_BACK_BUFFER_COUNT];
     int mCurrent;
+
+    // what was last programmed into each back buffer, back buffers are
+    // uncached so this is used instead of reading registers back
+    struct OverlayBackBufferState {
+        bool valid;
+        // inputs of buffer offset & coordinate setup
+        uint32_t format;
+        uint32_t width;
+        uint32_t height;
+        stride_t stride;
+        crop_t crop;
+        bool isProtected;
+        int bobDeinterlace;
+        // inputs of scaling setup
+        PlanePosition position;
+        int transform;
+        uint32_t hdisplay;
+        uint32_t vdisplay;
+        int panelOrientation;
+        // data buffer address
+        uint32_t gttOffsetInPage;
+        // OSTART_0Y, OSTART_0U, OSTART_0V, OSTART_1Y, OSTART_1U, OSTART_1V
+        uint32_t ostart[OVERLAY_SURFACE_ADDRESS_COUNT];
+        // YRGBSCALE, UVSCALE, UVSCALEV
+        uint32_t scale[3];
+    } mBackBufferState[OVERLAY_BACK_BUFFER_COUNT];
+
+    // scaling whose coefficients are loaded in hardware
+    uint32_t mLoadedScale[3];
+    bool mCoeffLoaded;
+
+    struct {
+        uint32_t fullUpdates;
+        uint32_t addressUpdates;
+        uint32_t coeffLoads;
+    } mBackBufferStats;
     // wsbm
     Wsbm *mWsbm;
     // pipe config
     uint32_t mPipeConfig;
 
     int mBobDeinterlace;
+
+private:
+    DECLARE_THREAD(DeferredFlipThread, OverlayPlaneBase);
 };
 
 } // namespace intel
@@ -0,0 +1,211 @@
+/*
+// Copyright (c) 2014 Intel Corporation 
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#include <string.h>
+#include <common/utils/HwcTrace.h>
+#include <ips/common/VideoFlipPacer.h>
+
+namespace android {
+namespace intel {
+
+VideoFlipPacer::VideoFlipPacer()
+{
+    memset(&mStats, 0, sizeof(mStats));
+    reset();
+}
+
+VideoFlipPacer::~VideoFlipPacer()
+{
+}
+
+void VideoFlipPacer::reset()
+{
+    mPeriod = 0;
+    mLastVsync = 0;
+    mOffset = 0;
+    mLastTimestamp = 0;
+    mLateFrames = 0;
+    mMinLateness = 0;
+    mEarlyFrames = 0;
+    mMinEarliness = 0;
+    mTargetVsync = 0;
+    mLastPresentedVsync = 0;
+}
+
+nsecs_t VideoFlipPacer::nextVsync(nsecs_t time) const
+{
+    if (time <= mLastVsync) {
+        return mLastVsync + mPeriod;
+    }
+    nsecs_t n = (time - mLastVsync + mPeriod - 1) / mPeriod;
+    return mLastVsync + n * mPeriod;
+}
+
+void VideoFlipPacer::rebase(int64_t timestamp, nsecs_t now)
+{
+    // present this frame on the next vsync and the others relative to it
+    mOffset = nextVsync(now) - us2ns(timestamp);
+    mLateFrames = 0;
+    mMinLateness = 0;
+    mEarlyFrames = 0;
+    mMinEarliness = 0;
+    mStats.rebases++;
+}
+
+nsecs_t VideoFlipPacer::schedule(int64_t timestamp, nsecs_t now,
+                                 nsecs_t period, nsecs_t lastVsync)
+{
+    mTargetVsync = 0;
+
+    // no usable vsync model, e.g. vsync is off
+    if (period <= 0 || lastVsync <= 0 || now - lastVsync > 4 * period) {
+        mLastTimestamp = 0;
+        return 0;
+    }
+
+    bool periodChanged = mPeriod &&
+        (period > mPeriod + mPeriod / 16 || period < mPeriod - mPeriod / 16);
+    mPeriod = period;
+    mLastVsync = lastVsync;
+
+    int64_t gap = timestamp - mLastTimestamp;
+    bool discontinuity = !mLastTimestamp || gap <= 0 || gap > MAX_FRAME_GAP_US;
+    mLastTimestamp = timestamp;
+    if (discontinuity || periodChanged) {
+        rebase(timestamp, now);
+    }
+
+    // snap the ideal presentation time to the nearest vsync
+    nsecs_t ideal = us2ns(timestamp) + mOffset;
+    nsecs_t n = (ideal - mLastVsync + mPeriod / 2) / mPeriod;
+    mTargetVsync = mLastVsync + n * mPeriod;
+    mStats.frames++;
+
+    nsecs_t next = nextVsync(now);
+    if (mTargetVsync < next) {
+        // arrived too late for its vsync, move the schedule later if
+        // this keeps happening so frames stop queuing behind each other
+        mStats.late++;
+        nsecs_t lateness = next - mTargetVsync;
+        if (!mLateFrames || lateness < mMinLateness) {
+            mMinLateness = lateness;
+        }
+        if (++mLateFrames >= LATE_REBASE_COUNT) {
+            VLOGTRACE("video frames late by %lld ns, move schedule", mMinLateness);
+            mOffset += mMinLateness;
+            mLateFrames = 0;
+            mMinLateness = 0;
+            mStats.rebases++;
+        }
+        mEarlyFrames = 0;
+        return 0;
+    }
+    mLateFrames = 0;
+
+    if (mTargetVsync == next) {
+        mEarlyFrames = 0;
+        return 0;
+    }
+
+    // early, flip just after the vsync preceding the target
+    nsecs_t hold = mTargetVsync - mPeriod + us2ns(FLIP_MARGIN_US) - now;
+    if (hold > mPeriod) {
+        // more than one vsync ahead, e.g. after the schedule was moved
+        // later for a burst of late frames. Show the frame on the vsync
+        // after next and move the schedule earlier if this keeps happening
+        mStats.early++;
+        nsecs_t earliness = mTargetVsync - next - mPeriod;
+        if (!mEarlyFrames || earliness < mMinEarliness) {
+            mMinEarliness = earliness;
+        }
+        if (++mEarlyFrames >= EARLY_ADVANCE_COUNT) {
+            VLOGTRACE("video frames early by %lld ns, move schedule", mMinEarliness);
+            mOffset -= mMinEarliness;
+            mEarlyFrames = 0;
+            mMinEarliness = 0;
+            mStats.advances++;
+        }
+        mTargetVsync = next + mPeriod;
+        hold = next + us2ns(FLIP_MARGIN_US) - now;
+    } else {
+        mEarlyFrames = 0;
+    }
+    if (hold <= 0) {
+        return 0;
+    }
+
+    mStats.held++;
+    return hold;
+}
+
+void VideoFlipPacer::onFlip(nsecs_t now)
+{
+    if (!mTargetVsync || !mPeriod) {
+        return;
+    }
+
+    nsecs_t presented = nextVsync(now);
+
+    int error = (int)((presented - mTargetVsync) / mPeriod);
+    error += ERROR_BUCKETS / 2;
+    if (error < 0) {
+        error = 0;
+    } else if (error >= ERROR_BUCKETS) {
+        error = ERROR_BUCKETS - 1;
+    }
+    mStats.errors[error]++;
+
+    if (mLastPresentedVsync) {
+        nsecs_t interval = (presented - mLastPresentedVsync + mPeriod / 2) / mPeriod;
+        if (interval < 0) {
+            interval = 0;
+        } else if (interval >= INTERVAL_BUCKETS) {
+            interval = INTERVAL_BUCKETS - 1;
+        }
+        mStats.intervals[interval]++;
+    }
+    mLastPresentedVsync = presented;
+    mTargetVsync = 0;
+}
+
+void VideoFlipPacer::onCancel()
+{
+    if (!mTargetVsync) {
+        return;
+    }
+    mStats.cancelled++;
+    mTargetVsync = 0;
+}
+
+void VideoFlipPacer::dump(Dump& d, int index)
+{
+    d.append("Overlay %d video pacing: %u frames, %u held, %u late, %u early, "
+             "%u cancelled, %u rebases, %u advances\n",
+             index, mStats.frames, mStats.held, mStats.late, mStats.early,
+             mStats.cancelled, mStats.rebases, mStats.advances);
+    d.append("  vsyncs per frame:");
+    for (int i = 0; i < INTERVAL_BUCKETS; i++) {
+        d.append(" %d%s:%u", i, i == INTERVAL_BUCKETS - 1 ? "+" : "",
+                 mStats.intervals[i]);
+    }
+    d.append("\n  vsyncs from ideal:");
+    for (int i = 0; i < ERROR_BUCKETS; i++) {
+        d.append(" %+d:%u", i - ERROR_BUCKETS / 2, mStats.errors[i]);
+    }
+    d.append("\n");
+}
+
+} // namespace intel
+} // namespace android
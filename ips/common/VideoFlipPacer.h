@@ -0,0 +1,96 @@
+/*
+// Copyright (c) 2014 Intel Corporation 
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#ifndef VIDEO_FLIP_PACER_H
+#define VIDEO_FLIP_PACER_H
+
+#include <utils/Timers.h>
+#include <common/utils/Dump.h>
+
+namespace android {
+namespace intel {
+
+// Paces overlay flips of video frames to the vsync their content
+// timestamp maps to, so the cadence of 24/25fps content on a 60Hz panel
+// does not depend on when the player queues frames.
+class VideoFlipPacer {
+public:
+    VideoFlipPacer();
+    ~VideoFlipPacer();
+
+public:
+    void reset();
+    // returns how long to hold the flip of a frame with the given content
+    // timestamp (in us) so it lands on its ideal vsync, 0 to flip now
+    nsecs_t schedule(int64_t timestamp, nsecs_t now,
+                     nsecs_t period, nsecs_t lastVsync);
+    // the frame scheduled last is flipped at the given time
+    void onFlip(nsecs_t now);
+    // the frame scheduled last is dropped or replaced before its flip
+    void onCancel();
+    void dump(Dump& d, int index);
+
+private:
+    nsecs_t nextVsync(nsecs_t time) const;
+    void rebase(int64_t timestamp, nsecs_t now);
+
+private:
+    enum {
+        // vsyncs between two presented frames, last bucket is 4 and more
+        INTERVAL_BUCKETS = 5,
+        // presented minus ideal vsync, from -2 to +2 and more
+        ERROR_BUCKETS = 5,
+        // consecutive late frames before the schedule is moved later
+        LATE_REBASE_COUNT = 4,
+        // consecutive frames more than a period early before the schedule
+        // is moved earlier
+        EARLY_ADVANCE_COUNT = 4,
+        // content timestamp gap treated as seek or pause
+        MAX_FRAME_GAP_US = 200000,
+        // flip is programmed this long after the vsync preceding the target
+        FLIP_MARGIN_US = 1000,
+    };
+
+    nsecs_t mPeriod;
+    nsecs_t mLastVsync;
+    // presentation time of content time 0
+    nsecs_t mOffset;
+    int64_t mLastTimestamp;
+    int mLateFrames;
+    nsecs_t mMinLateness;
+    int mEarlyFrames;
+    nsecs_t mMinEarliness;
+
+    // ideal vsync of the frame waiting for its flip, 0 if none
+    nsecs_t mTargetVsync;
+    nsecs_t mLastPresentedVsync;
+
+    struct {
+        uint32_t frames;
+        uint32_t held;
+        uint32_t late;
+        uint32_t early;
+        uint32_t cancelled;
+        uint32_t rebases;
+        uint32_t advances;
+        uint32_t intervals[INTERVAL_BUCKETS];
+        uint32_t errors[ERROR_BUCKETS];
+    } mStats;
+};
+
+} // namespace intel
+} // namespace android
+
+#endif /* VIDEO_FLIP_PACER_H */
@@ -65,6 +65,29 @@ struct VideoPayloadBuffer {
     uint32_t coded_height;
 };
 
+// copy of the payload fields hwc reads every frame, taken once per frame
+// so all readers see the same decoder state
+struct VideoPayloadSnapshot {
+    int client_transform;
+    int rotated_width;
+    int rotated_height;
+    int surface_protected;
+    int force_output_method;
+    uint32_t rotated_buffer_handle;
+    int bob_deinterlace;
+    int tiling;
+    uint32_t khandle;
+    int64_t  timestamp;
+    uint32_t scaling_khandle;
+    uint32_t scaling_width;
+    uint32_t scaling_height;
+    uint32_t scaling_luma_stride;
+    uint32_t scaling_chroma_u_stride;
+    uint32_t crop_width;
+    uint32_t crop_height;
+    uint32_t coded_width;
+    uint32_t coded_height;
+};
 
 // force output method values
 enum {
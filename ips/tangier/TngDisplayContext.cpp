@@ -13,7 +13,9 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 */
+#include <sync/sync.h>
 #include <common/utils/HwcTrace.h>
+#include <common/utils/HwcMetrics.h>
 #include <common/base/Drm.h>
 #include <Hwcomposer.h>
 #include <DisplayPlane.h>
@@ -105,6 +107,7 @@ bool TngDisplayContext::commitContents(hwc_display_contents_1_t *display, HwcLay
             continue;
         }
 
+        mPlaneFences[mCount] = plane->getReleaseFence();
         IMG_hwc_layer_t *imgLayer = &imgLayerList[mCount++];
         // update IMG layer
         imgLayer->psLayer = &display->hwLayers[i];
@@ -149,16 +152,23 @@ bool TngDisplayContext::commitEnd(size_t numDisplays, hwc_display_contents_1_t *
     VLOGTRACE("count = %d", mCount);
 
     if (mIMGDisplayDevice && mCount) {
+        PhaseTimer timer(HwcMetrics::PHASE_IMG_POST);
         int err = mIMGDisplayDevice->post(mIMGDisplayDevice,
                                           mImgLayers,
                                           mCount,
                                           &releaseFenceFd);
         if (err) {
             ELOGTRACE("post failed, err = %d", err);
+            HwcMetrics::increase(HwcMetrics::COUNTER_POST_FAILURES);
+            for (size_t i = 0; i < mCount; i++) {
+                closeFence(mPlaneFences[i]);
+            }
             return false;
         }
     }
 
+    PhaseTimer timer(HwcMetrics::PHASE_FENCE);
+
     // close acquire fence
     for (size_t i = 0; i < numDisplays; i++) {
         // Wait and close HWC_OVERLAY typed layer's acquire fence
@@ -203,7 +213,8 @@ bool TngDisplayContext::commitEnd(size_t numDisplays, hwc_display_contents_1_t *
         for (size_t i = 0; i < mCount; i++) {
             IMG_hwc_layer_t *imgLayer = &imgLayerList[i];
             imgLayer->psLayer->releaseFenceFd =
-                (releaseFenceFd != -1) ? dup(releaseFenceFd) : -1;
+                mergeFence(releaseFenceFd, mPlaneFences[i]);
+            closeFence(mPlaneFences[i]);
         }
     }
 
@@ -238,6 +249,33 @@ bool TngDisplayContext::commitEnd(size_t numDisplays, hwc_display_contents_1_t *
     return true;
 }
 
+int TngDisplayContext::mergeFence(int releaseFenceFd, int planeFenceFd)
+{
+    if (planeFenceFd == -1) {
+        return (releaseFenceFd != -1) ? dup(releaseFenceFd) : -1;
+    }
+    if (releaseFenceFd == -1) {
+        return dup(planeFenceFd);
+    }
+
+    int fence = sync_merge("hwc_release", releaseFenceFd, planeFenceFd);
+    if (fence < 0) {
+        // the buffer is then released before the plane is done with it,
+        // waiting here for the plane would stall the commit
+        ELOGTRACE("failed to merge release fence");
+        return dup(releaseFenceFd);
+    }
+    return fence;
+}
+
+void TngDisplayContext::closeFence(int& fenceFd)
+{
+    if (fenceFd != -1) {
+        close(fenceFd);
+        fenceFd = -1;
+    }
+}
+
 bool TngDisplayContext::compositionComplete()
 {
     return true;
@@ -39,8 +39,16 @@ private:
     enum {
         MAXIMUM_LAYER_NUMBER = 20,
     };
+
+    // release fence of a layer, owned by the caller
+    int mergeFence(int releaseFenceFd, int planeFenceFd);
+    void closeFence(int& fenceFd);
+
+private:
     IMG_display_device_public_t *mIMGDisplayDevice;
     IMG_hwc_layer_t mImgLayers[MAXIMUM_LAYER_NUMBER];
+    // from DisplayPlane::getReleaseFence, -1 if none
+    int mPlaneFences[MAXIMUM_LAYER_NUMBER];
     bool mInitialized;
     size_t mCount;
 };
@@ -19,8 +19,10 @@
 namespace android {
 namespace intel {
 
-TngGrallocBuffer::TngGrallocBuffer(uint32_t handle)
-    :GrallocBufferBase(handle)
+TngGrallocBuffer::TngGrallocBuffer(IMG_gralloc_module_public_t *module,
+                                   uint32_t handle)
+    :GrallocBufferBase(handle),
+     mIMGGrallocModule(module)
 {
     initBuffer(handle);
 }
@@ -55,6 +57,24 @@ void TngGrallocBuffer::initBuffer(uint32_t handle)
 
     // stride can only be initialized after format is set
     initStride();
+
+    setIsCompression(isCompressionUsage(mUsage) &&
+                     isCompressibleFormat(mFormat));
+}
+
+bool TngGrallocBuffer::isCompressibleFormat(uint32_t format) const
+{
+    if (!mIMGGrallocModule || !mIMGGrallocModule->GetBufferFormat) {
+        return false;
+    }
+
+    const IMG_buffer_format_public_t *bufferFormat =
+        mIMGGrallocModule->GetBufferFormat(format);
+    if (!bufferFormat) {
+        return false;
+    }
+
+    return !(bufferFormat->uiFlags & IMG_BFF_NEVER_COMPRESS);
 }
 
 
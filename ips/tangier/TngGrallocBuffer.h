@@ -28,13 +28,16 @@ typedef IMG_native_handle_t TngIMGGrallocBuffer;
 
 class TngGrallocBuffer : public GrallocBufferBase {
 public:
-    TngGrallocBuffer(uint32_t handle);
+    TngGrallocBuffer(IMG_gralloc_module_public_t *module, uint32_t handle);
     virtual ~TngGrallocBuffer();
 
     void resetBuffer(uint32_t handle);
 
 private:
     void initBuffer(uint32_t handle);
+    bool isCompressibleFormat(uint32_t format) const;
+private:
+    IMG_gralloc_module_public_t *mIMGGrallocModule;
 };
 
 } // namespace intel
@@ -23,25 +23,20 @@ namespace android {
 namespace intel {
 
 TngGrallocBufferMapper::TngGrallocBufferMapper(IMG_gralloc_module_public_t& module,
+                                                    GrallocHandleCache& handleCache,
                                                     DataBuffer& buffer)
     : GrallocBufferMapperBase(buffer),
       mIMGGrallocModule(module),
+      mHandleCache(handleCache),
       mBufferObject(0)
 {
     CTRACE();
 
-    const native_handle_t *h = (native_handle_t *)mHandle;
-
-    mClonedHandle = native_handle_create(h->numFds, h->numInts);
+    // clone is shared by all mappers of the same buffer
+    mClonedHandle = mHandleCache.acquire(mKey, (native_handle_t *)mHandle);
     if (mClonedHandle == 0) {
-        ALOGE("%s:Failed to create handle, out of memory!");
-        return;
-    }
-    for (int i = 0; i < h->numFds; i++)
-    {
-        mClonedHandle->data[i] = (h->data[i] >= 0) ? dup(h->data[i]) : -1;
+        ELOGTRACE("failed to clone handle %#x", mHandle);
     }
-    memcpy(mClonedHandle->data + h->numFds, h->data + h->numFds, h->numInts*sizeof(int));
 }
 
 TngGrallocBufferMapper::~TngGrallocBufferMapper()
@@ -50,8 +45,7 @@ TngGrallocBufferMapper::~TngGrallocBufferMapper()
 
     if (mClonedHandle == 0)
        return;
-    native_handle_close(mClonedHandle);
-    native_handle_delete(mClonedHandle);
+    mHandleCache.release(mKey);
 }
 
 bool TngGrallocBufferMapper::gttMap(void *vaddr,
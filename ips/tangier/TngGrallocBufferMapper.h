@@ -18,6 +18,7 @@
 
 #include <BufferMapper.h>
 #include <ips/common/GrallocBufferMapperBase.h>
+#include <ips/common/GrallocHandleCache.h>
 #include <ips/tangier/TngGrallocBuffer.h>
 
 namespace android {
@@ -26,6 +27,7 @@ namespace intel {
 class TngGrallocBufferMapper : public GrallocBufferMapperBase {
 public:
     TngGrallocBufferMapper(IMG_gralloc_module_public_t& module,
+                               GrallocHandleCache& handleCache,
                                DataBuffer& buffer);
     virtual ~TngGrallocBufferMapper();
 public:
@@ -41,6 +43,7 @@ private:
 
 private:
     IMG_gralloc_module_public_t& mIMGGrallocModule;
+    GrallocHandleCache& mHandleCache;
     void* mBufferObject;
     native_handle_t* mClonedHandle;
 };
@@ -40,12 +40,20 @@ bool PlatfBufferManager::initialize()
 void PlatfBufferManager::deinitialize()
 {
     BufferManager::deinitialize();
+    // all mappers are gone, close the remaining idle clones
+    mHandleCache.deinitialize();
 }
 
-DataBuffer* PlatfBufferManager::createDataBuffer(gralloc_module_t * /* module */,
+void PlatfBufferManager::dump(Dump& d)
+{
+    BufferManager::dump(d);
+    mHandleCache.dump(d);
+}
+
+DataBuffer* PlatfBufferManager::createDataBuffer(gralloc_module_t *module,
         uint32_t handle)
 {
-    return new TngGrallocBuffer(handle);
+    return new TngGrallocBuffer((IMG_gralloc_module_public_t*)module, handle);
 }
 
 BufferMapper* PlatfBufferManager::createBufferMapper(gralloc_module_t *module,
@@ -55,6 +63,7 @@ BufferMapper* PlatfBufferManager::createBufferMapper(gralloc_module_t *module,
         return 0;
 
     return new TngGrallocBufferMapper(*(IMG_gralloc_module_public_t*)module,
+                                        mHandleCache,
                                         buffer);
 }
 
@@ -63,6 +72,7 @@ bool PlatfBufferManager::blitGrallocBuffer(uint32_t srcHandle, uint32_t dstHandl
 
 {
     IMG_gralloc_module_public_t *imgGrallocModule = (IMG_gralloc_module_public_t *) mGrallocModule;
+    Mutex::Autolock _l(mBlitLock);
     if (imgGrallocModule->Blit(imgGrallocModule, (buffer_handle_t)srcHandle,
                                 (buffer_handle_t)dstHandle,
                                 srcCrop.w, srcCrop.h, srcCrop.x,
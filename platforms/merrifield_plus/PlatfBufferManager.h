@@ -17,6 +17,7 @@
 #define PLATF_BUFFER_MANAGER_H
 
 #include <BufferManager.h>
+#include <ips/common/GrallocHandleCache.h>
 
 namespace android {
 namespace intel {
@@ -29,6 +30,7 @@ public:
 public:
     bool initialize();
     void deinitialize();
+    void dump(Dump& d);
 
 protected:
     DataBuffer* createDataBuffer(gralloc_module_t *module, uint32_t handle);
@@ -36,6 +38,11 @@ protected:
                                         DataBuffer& buffer);
     bool blitGrallocBuffer(uint32_t srcHandle, uint32_t dstHandle,
                                   crop_t& srcCrop, uint32_t async);
+
+private:
+    GrallocHandleCache mHandleCache;
+    // planes of two pipes may be flipped concurrently
+    Mutex mBlitLock;
 };
 
 }
@@ -68,6 +68,11 @@ IDisplayDevice* PlatfHwcomposer::createDisplayDevice(int disp,
 #ifdef INTEL_SUPPORT_HDMI_PRIMARY
             return new DummyDevice((uint32_t)disp, *this);
 #else
+            // a headless display takes the slot of the HDMI display
+            if (DummyDevice::isHeadlessEnabled()) {
+                ILOGTRACE("external display replaced by a headless display");
+                return new DummyDevice((uint32_t)disp, *this);
+            }
             return new PlatfExternalDevice(*this, dpm);
 #endif
 
@@ -0,0 +1,140 @@
+/*
+// Copyright (c) 2014 Intel Corporation 
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#include <string.h>
+#include <common/utils/HwcTrace.h>
+#include <DisplayQuery.h>
+#include <tools/hwcreplay/ReplayBufferManager.h>
+
+namespace android {
+namespace intel {
+
+ReplayBufferManager::ReplayBufferManager()
+    : BufferManager(),
+      mBuffers(),
+      mBuffer(),
+      mBufferLock()
+{
+    CTRACE();
+}
+
+ReplayBufferManager::~ReplayBufferManager()
+{
+    CTRACE();
+}
+
+bool ReplayBufferManager::initialize()
+{
+    // no gralloc and no map-ahead thread, buffers only live in the trace
+    return true;
+}
+
+void ReplayBufferManager::deinitialize()
+{
+    Mutex::Autolock _l(mBufferLock);
+    mBuffers.clear();
+}
+
+void ReplayBufferManager::dump(Dump& d)
+{
+    Mutex::Autolock _l(mBufferLock);
+    d.append("Replay buffer manager: %d traced buffers\n", mBuffers.size());
+}
+
+void ReplayBufferManager::addBuffer(const frame_trace_layer& layer)
+{
+    if (!layer.handle) {
+        return;
+    }
+
+    // handles get reused, the latest frame describes the buffer
+    BufferInfo info;
+    info.format = layer.format;
+    info.width = layer.width;
+    info.height = layer.height;
+
+    Mutex::Autolock _l(mBufferLock);
+    mBuffers.replaceValueFor(layer.handle, info);
+}
+
+DataBuffer* ReplayBufferManager::lockDataBuffer(uint32_t handle)
+{
+    mBufferLock.lock();
+
+    ssize_t index = mBuffers.indexOfKey(handle);
+    if (index < 0) {
+        mBufferLock.unlock();
+        return NULL;
+    }
+
+    const BufferInfo& info = mBuffers.valueAt(index);
+    mBuffer.resetBuffer(handle);
+    mBuffer.setFormat(info.format);
+    mBuffer.setWidth(info.width);
+    mBuffer.setHeight(info.height);
+
+    // the trace has no stride, assume a tightly packed buffer
+    stride_t stride;
+    memset(&stride, 0, sizeof(stride));
+    if (DisplayQuery::isVideoFormat(info.format)) {
+        stride.yuv.yStride = align_to(info.width, 64);
+        stride.yuv.uvStride = stride.yuv.yStride;
+    } else {
+        stride.rgb.stride = align_to(info.width * 4, 64);
+    }
+    mBuffer.setStride(stride);
+
+    // usage isn't recorded either, nothing replays as protected
+    mBuffer.setUsage(GraphicBuffer::USAGE_INVALID);
+    return &mBuffer;
+}
+
+void ReplayBufferManager::unlockDataBuffer(DataBuffer * /* buffer */)
+{
+    mBufferLock.unlock();
+}
+
+uint32_t ReplayBufferManager::allocFrameBuffer(int /* width */, int /* height */,
+                                               int * /* stride */)
+{
+    return 0;
+}
+
+void ReplayBufferManager::freeFrameBuffer(uint32_t /* kHandle */)
+{
+}
+
+bool ReplayBufferManager::blitGrallocBuffer(uint32_t /* srcHandle */,
+                                            uint32_t /* dstHandle */,
+                                            crop_t& /* srcCrop */,
+                                            uint32_t /* async */)
+{
+    return false;
+}
+
+DataBuffer* ReplayBufferManager::createDataBuffer(gralloc_module_t * /* module */,
+                                                  uint32_t /* handle */)
+{
+    return NULL;
+}
+
+BufferMapper* ReplayBufferManager::createBufferMapper(gralloc_module_t * /* module */,
+                                                      DataBuffer& /* buffer */)
+{
+    return NULL;
+}
+
+} // namespace intel
+} // namespace android
@@ -0,0 +1,79 @@
+/*
+// Copyright (c) 2014 Intel Corporation 
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#ifndef REPLAY_BUFFER_MANAGER_H
+#define REPLAY_BUFFER_MANAGER_H
+
+#include <utils/KeyedVector.h>
+#include <utils/threads.h>
+#include <common/utils/FrameTraceFormat.h>
+#include <BufferManager.h>
+#include <GraphicBuffer.h>
+
+namespace android {
+namespace intel {
+
+// buffer rebuilt from the attributes recorded in a frame trace
+class ReplayBuffer : public GraphicBuffer {
+public:
+    ReplayBuffer() : GraphicBuffer(0) {}
+    virtual ~ReplayBuffer() {}
+
+    void setUsage(uint32_t usage) { mUsage = usage; }
+};
+
+// buffer manager standing in for gralloc during a replay, buffer queries
+// are answered from the trace and nothing is allocated or mapped
+class ReplayBufferManager : public BufferManager {
+public:
+    ReplayBufferManager();
+    virtual ~ReplayBufferManager();
+
+public:
+    virtual bool initialize();
+    virtual void deinitialize();
+    virtual void dump(Dump& d);
+    virtual DataBuffer* lockDataBuffer(uint32_t handle);
+    virtual void unlockDataBuffer(DataBuffer *buffer);
+    virtual uint32_t allocFrameBuffer(int width, int height, int *stride);
+    virtual void freeFrameBuffer(uint32_t kHandle);
+    virtual bool blitGrallocBuffer(uint32_t srcHandle, uint32_t dstHandle,
+                                  crop_t& srcCrop, uint32_t async);
+
+    // records the attributes of the buffer behind a traced handle
+    void addBuffer(const frame_trace_layer& layer);
+
+protected:
+    virtual DataBuffer* createDataBuffer(gralloc_module_t *module,
+                                             uint32_t handle);
+    virtual BufferMapper* createBufferMapper(gralloc_module_t *module,
+                                                 DataBuffer& buffer);
+
+private:
+    struct BufferInfo {
+        uint32_t format;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    KeyedVector<uint32_t, BufferInfo> mBuffers;
+    ReplayBuffer mBuffer;
+    Mutex mBufferLock;
+};
+
+} // namespace intel
+} // namespace android
+
+#endif /* REPLAY_BUFFER_MANAGER_H */
@@ -0,0 +1,61 @@
+/*
+// Copyright (c) 2014 Intel Corporation 
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#include <common/utils/HwcTrace.h>
+#include <Hwcomposer.h>
+#include <tools/hwcreplay/ReplayDevice.h>
+
+namespace android {
+namespace intel {
+
+ReplayDevice::ReplayDevice(uint32_t type, Hwcomposer& hwc,
+                           int spritePlanes, int overlayPlanes)
+    : DummyDevice(type, hwc),
+      mReplaySprites(spritePlanes),
+      mReplayOverlays(overlayPlanes)
+{
+    CTRACE();
+    mName = "Replay";
+}
+
+ReplayDevice::~ReplayDevice()
+{
+    CTRACE();
+}
+
+const char* ReplayDevice::getName() const
+{
+    return "Replay";
+}
+
+void ReplayDevice::loadConfig()
+{
+    // always headless, sized as the mode the replay Drm reports
+    mConnected = true;
+    mSpritePlanes = mReplaySprites;
+    mOverlayPlanes = mReplayOverlays;
+
+    uint32_t width, height;
+    if (mHwc.getDrm()->getDisplayResolution(mType, width, height)) {
+        mWidth = width;
+        mHeight = height;
+    }
+
+    ILOGTRACE("replay display %d: %dx%d@%d, %d sprites, %d overlays", mType,
+        mWidth, mHeight, mRefreshRate, mSpritePlanes, mOverlayPlanes);
+}
+
+} // namespace intel
+} // namespace android
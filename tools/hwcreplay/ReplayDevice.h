@@ -0,0 +1,46 @@
+/*
+// Copyright (c) 2014 Intel Corporation 
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#ifndef REPLAY_DEVICE_H
+#define REPLAY_DEVICE_H
+
+#include <DummyDevice.h>
+
+namespace android {
+namespace intel {
+
+// headless display taking the traced layers of a physical display slot,
+// it runs the layer list on private planes and releases buffers at commit
+class ReplayDevice : public DummyDevice {
+public:
+    ReplayDevice(uint32_t type, Hwcomposer& hwc,
+                 int spritePlanes, int overlayPlanes);
+    virtual ~ReplayDevice();
+
+public:
+    virtual const char* getName() const;
+
+protected:
+    virtual void loadConfig();
+
+private:
+    int mReplaySprites;
+    int mReplayOverlays;
+};
+
+} // namespace intel
+} // namespace android
+
+#endif /* REPLAY_DEVICE_H */
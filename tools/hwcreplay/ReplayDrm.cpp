@@ -0,0 +1,240 @@
+/*
+// Copyright (c) 2014 Intel Corporation 
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#include <stdio.h>
+#include <string.h>
+#include <common/utils/HwcTrace.h>
+#include <common/base/Drm.h>
+#include <IDisplayDevice.h>
+
+// Drm of the replay tool, linked in place of common/base/Drm.cpp. It
+// never opens the DRM device, every output reports one fixed mode so
+// planes and layer lists see the same panel on each run.
+
+namespace android {
+namespace intel {
+
+enum {
+    REPLAY_MODE_WIDTH = 1920,
+    REPLAY_MODE_HEIGHT = 1080,
+    REPLAY_MODE_REFRESH = 60,
+};
+
+Drm::Drm()
+    : mDrmFd(-1),
+      mLock(),
+      mInitialized(false)
+{
+    memset(&mOutputs, 0, sizeof(mOutputs));
+}
+
+Drm::~Drm()
+{
+    WARN_IF_NOT_DEINIT();
+}
+
+bool Drm::initialize()
+{
+    if (mInitialized) {
+        WLOGTRACE("Drm object has been initialized");
+        return true;
+    }
+
+    for (int i = 0; i < OUTPUT_MAX; i++) {
+        initDrmMode(i);
+    }
+
+    mInitialized = true;
+    return true;
+}
+
+void Drm::deinitialize()
+{
+    for (int i = 0; i < OUTPUT_MAX; i++) {
+        resetOutput(i);
+    }
+    mInitialized = false;
+}
+
+bool Drm::initDrmMode(int index)
+{
+    DrmOutput *output = &mOutputs[index];
+    drmModeModeInfo& mode = output->mode;
+
+    memset(&mode, 0, sizeof(mode));
+    mode.hdisplay = REPLAY_MODE_WIDTH;
+    mode.vdisplay = REPLAY_MODE_HEIGHT;
+    mode.vrefresh = REPLAY_MODE_REFRESH;
+    mode.type = DRM_MODE_TYPE_PREFERRED;
+    snprintf(mode.name, sizeof(mode.name), "%dx%d",
+             REPLAY_MODE_WIDTH, REPLAY_MODE_HEIGHT);
+
+    output->connected = true;
+    output->panelOrientation = PANEL_ORIENTATION_0;
+    return true;
+}
+
+void Drm::resetOutput(int index)
+{
+    memset(&mOutputs[index], 0, sizeof(DrmOutput));
+}
+
+inline int Drm::getOutputIndex(int device)
+{
+    switch (device) {
+    case IDisplayDevice::DEVICE_PRIMARY:
+        return OUTPUT_PRIMARY;
+    case IDisplayDevice::DEVICE_EXTERNAL:
+        return OUTPUT_EXTERNAL;
+    default:
+        return -1;
+    }
+}
+
+bool Drm::detect(int device)
+{
+    return isConnected(device);
+}
+
+bool Drm::isSameDrmMode(drmModeModeInfoPtr value,
+        drmModeModeInfoPtr base) const
+{
+    return base->hdisplay == value->hdisplay &&
+           base->vdisplay == value->vdisplay &&
+           base->vrefresh == value->vrefresh &&
+           (base->flags & value->flags) == value->flags;
+}
+
+bool Drm::setDrmMode(int device, drmModeModeInfo& value)
+{
+    Mutex::Autolock _l(mLock);
+
+    int outputIndex = getOutputIndex(device);
+    if (outputIndex < 0) {
+        return false;
+    }
+    return isSameDrmMode(&value, &mOutputs[outputIndex].mode);
+}
+
+bool Drm::setDrmMode(int /* index */, drmModeModeInfoPtr /* mode */)
+{
+    return false;
+}
+
+bool Drm::setRefreshRate(int /* device */, int hz)
+{
+    return hz == REPLAY_MODE_REFRESH;
+}
+
+bool Drm::writeReadIoctl(unsigned long /* cmd */, void * /* data */,
+                         unsigned long /* size */)
+{
+    return false;
+}
+
+bool Drm::writeIoctl(unsigned long /* cmd */, void * /* data */,
+                     unsigned long /* size */)
+{
+    return false;
+}
+
+bool Drm::readIoctl(unsigned long /* cmd */, void * /* data */,
+                    unsigned long /* size */)
+{
+    return false;
+}
+
+bool Drm::isConnected(int device)
+{
+    Mutex::Autolock _l(mLock);
+
+    int outputIndex = getOutputIndex(device);
+    if (outputIndex < 0) {
+        return false;
+    }
+    return mOutputs[outputIndex].connected;
+}
+
+bool Drm::setDpmsMode(int device, int /* mode */)
+{
+    return isConnected(device);
+}
+
+int Drm::getDrmFd() const
+{
+    return mDrmFd;
+}
+
+bool Drm::getModeInfo(int device, drmModeModeInfo& mode)
+{
+    Mutex::Autolock _l(mLock);
+
+    int outputIndex = getOutputIndex(device);
+    if (outputIndex < 0 || !mOutputs[outputIndex].connected) {
+        return false;
+    }
+    mode = mOutputs[outputIndex].mode;
+    return true;
+}
+
+bool Drm::getPhysicalSize(int /* device */, uint32_t& width, uint32_t& height)
+{
+    // no EDID, the size is unknown
+    width = 0;
+    height = 0;
+    return false;
+}
+
+bool Drm::getDisplayResolution(int device, uint32_t& width, uint32_t& height)
+{
+    Mutex::Autolock _l(mLock);
+
+    int outputIndex = getOutputIndex(device);
+    if (outputIndex < 0 || !mOutputs[outputIndex].connected) {
+        return false;
+    }
+    width = mOutputs[outputIndex].mode.hdisplay;
+    height = mOutputs[outputIndex].mode.vdisplay;
+    return true;
+}
+
+int Drm::getPanelOrientation(int device)
+{
+    int outputIndex = getOutputIndex(device);
+    if (outputIndex < 0) {
+        return PANEL_ORIENTATION_0;
+    }
+    return mOutputs[outputIndex].panelOrientation;
+}
+
+drmModeModeInfoPtr Drm::detectAllConfigs(int device, int *modeCount)
+{
+    if (!modeCount) {
+        return NULL;
+    }
+
+    Mutex::Autolock _l(mLock);
+    *modeCount = 0;
+
+    int outputIndex = getOutputIndex(device);
+    if (outputIndex < 0 || !mOutputs[outputIndex].connected) {
+        return NULL;
+    }
+    *modeCount = 1;
+    return &mOutputs[outputIndex].mode;
+}
+
+} // namespace intel
+} // namespace android
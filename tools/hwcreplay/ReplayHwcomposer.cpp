@@ -0,0 +1,107 @@
+/*
+// Copyright (c) 2014 Intel Corporation 
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#include <common/utils/HwcTrace.h>
+#include <common/planes/DummyPlaneManager.h>
+#include <DummyDevice.h>
+#include <IDisplayDevice.h>
+#include <PlaneCapabilities.h>
+#include <tools/hwcreplay/ReplayDevice.h>
+#include <tools/hwcreplay/ReplayHwcomposer.h>
+
+namespace android {
+namespace intel {
+
+enum {
+    // defaults match the Anniedale sprite and overlay planes
+    DEFAULT_SPRITE_PLANES = 3,
+    DEFAULT_OVERLAY_PLANES = 2,
+};
+
+ReplayHwcomposer::ReplayHwcomposer()
+    : Hwcomposer(),
+      mSpritePlanes(DEFAULT_SPRITE_PLANES),
+      mOverlayPlanes(DEFAULT_OVERLAY_PLANES)
+{
+    CTRACE();
+}
+
+ReplayHwcomposer::~ReplayHwcomposer()
+{
+    CTRACE();
+}
+
+void ReplayHwcomposer::setPlaneBudget(int spritePlanes, int overlayPlanes)
+{
+    mSpritePlanes = spritePlanes;
+    mOverlayPlanes = overlayPlanes;
+}
+
+ReplayBufferManager* ReplayHwcomposer::getReplayBufferManager()
+{
+    return static_cast<ReplayBufferManager*>(mBufferManager);
+}
+
+DisplayPlaneManager* ReplayHwcomposer::createDisplayPlaneManager()
+{
+    CTRACE();
+    // filled by the Anniedale plane manager on the device
+    PlaneCapabilities::initialize();
+
+    // replay devices allocate from their own planes, the shared pool
+    // only holds the primary planes
+    return (new DummyPlaneManager(0, 0));
+}
+
+BufferManager* ReplayHwcomposer::createBufferManager()
+{
+    CTRACE();
+    return (new ReplayBufferManager());
+}
+
+IDisplayDevice* ReplayHwcomposer::createDisplayDevice(int disp,
+                                                      DisplayPlaneManager& /* dpm */)
+{
+    CTRACE();
+
+    switch (disp) {
+        case IDisplayDevice::DEVICE_PRIMARY:
+        case IDisplayDevice::DEVICE_EXTERNAL:
+            return new ReplayDevice((uint32_t)disp, *this,
+                                    mSpritePlanes, mOverlayPlanes);
+
+        case IDisplayDevice::DEVICE_VIRTUAL:
+            return new DummyDevice((uint32_t)disp, *this);
+
+        default:
+            ELOGTRACE("invalid display device %d", disp);
+            return NULL;
+    }
+}
+
+IDisplayContext* ReplayHwcomposer::createDisplayContext()
+{
+    CTRACE();
+    return new ReplayDisplayContext();
+}
+
+Hwcomposer* Hwcomposer::createHwcomposer()
+{
+    CTRACE();
+    return new ReplayHwcomposer();
+}
+
+} // namespace intel
+} // namespace android
@@ -0,0 +1,70 @@
+/*
+// Copyright (c) 2014 Intel Corporation 
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#ifndef REPLAY_HWCOMPOSER_H
+#define REPLAY_HWCOMPOSER_H
+
+#include <Hwcomposer.h>
+#include <IDisplayContext.h>
+#include <tools/hwcreplay/ReplayBufferManager.h>
+
+namespace android {
+namespace intel {
+
+// nothing is flipped during a replay, commits only reach the devices
+class ReplayDisplayContext : public IDisplayContext {
+public:
+    ReplayDisplayContext() {}
+    virtual ~ReplayDisplayContext() {}
+public:
+    virtual bool initialize() { return true; }
+    virtual void deinitialize() {}
+    virtual bool commitBegin(size_t /* numDisplays */,
+                             hwc_display_contents_1_t ** /* displays */) { return true; }
+    virtual bool commitContents(hwc_display_contents_1_t * /* display */,
+                                HwcLayerList * /* layerList */) { return true; }
+    virtual bool commitEnd(size_t /* numDisplays */,
+                           hwc_display_contents_1_t ** /* displays */) { return true; }
+    virtual bool compositionComplete() { return true; }
+    virtual bool setCursorPosition(int /* disp */, int /* x */, int /* y */) { return true; }
+};
+
+// hwcomposer of the replay tool, its primary and external displays are
+// replay devices and buffers come from the trace
+class ReplayHwcomposer : public Hwcomposer {
+public:
+    ReplayHwcomposer();
+    virtual ~ReplayHwcomposer();
+
+public:
+    // plane budget of each replayed display, set before initialize
+    void setPlaneBudget(int spritePlanes, int overlayPlanes);
+    ReplayBufferManager* getReplayBufferManager();
+
+protected:
+    DisplayPlaneManager* createDisplayPlaneManager();
+    BufferManager* createBufferManager();
+    IDisplayDevice* createDisplayDevice(int disp, DisplayPlaneManager& dpm);
+    IDisplayContext* createDisplayContext();
+
+private:
+    int mSpritePlanes;
+    int mOverlayPlanes;
+};
+
+} // namespace intel
+} // namespace android
+
+#endif /* REPLAY_HWCOMPOSER_H */
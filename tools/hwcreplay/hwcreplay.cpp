@@ -0,0 +1,429 @@
+/*
+// Copyright (c) 2014 Intel Corporation 
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <utils/threads.h>
+#include <utils/Timers.h>
+#include <common/utils/FrameTraceFormat.h>
+#include <tools/hwcreplay/ReplayHwcomposer.h>
+
+// Replays a frame trace saved by FrameTracer through Hwcomposer prepare
+// and commit. Drm, DisplayQuery, gralloc and the display context are
+// stubbed, and the primary and external displays are headless replay
+// devices with their own planes. The composition picked for each traced
+// layer is compared with the one recorded on the device.
+
+using namespace android;
+using namespace android::intel;
+
+enum {
+    // virtual displays stay in GLES composition
+    REPLAY_DISPLAY_COUNT = 2,
+    REPLAY_LAYER_COUNT = 16,
+    MAX_REPLAY_PLANES = 8,
+    HOTPLUG_WAIT_MS = 500,
+    DUMP_BUFFER_SIZE = 64 * 1024,
+};
+
+struct LatencyStat {
+    int64_t count;
+    int64_t total;
+    int64_t max;
+};
+
+struct ReplayDisplay {
+    hwc_display_contents_1_t *contents;
+    // contents were handed to the last prepare
+    bool active;
+    uint32_t frames;
+    uint32_t truncated;
+    uint32_t layers;
+    uint32_t recordedOverlays;
+    uint32_t replayedOverlays;
+    uint32_t mismatches;
+};
+
+static Mutex sHotplugLock;
+static Condition sHotplugCond;
+static int sHotplugCount = 0;
+
+static void addLatency(LatencyStat& stat, int64_t ns)
+{
+    stat.count++;
+    stat.total += ns;
+    if (ns > stat.max) {
+        stat.max = ns;
+    }
+}
+
+static void printLatency(const char *name, const LatencyStat& recorded,
+                         const LatencyStat& replayed)
+{
+    if (!recorded.count || !replayed.count) {
+        return;
+    }
+    printf("%s: recorded avg %lld us, max %lld us; "
+           "replayed avg %lld us, max %lld us\n",
+           name,
+           (long long)(recorded.total / recorded.count / 1000),
+           (long long)(recorded.max / 1000),
+           (long long)(replayed.total / replayed.count / 1000),
+           (long long)(replayed.max / 1000));
+}
+
+static void hotplugProc(const struct hwc_procs * /* procs */, int disp, int connected)
+{
+    printf("hotplug: display %d %s\n", disp, connected ? "connected" : "disconnected");
+
+    Mutex::Autolock _l(sHotplugLock);
+    if (connected) {
+        sHotplugCount++;
+    }
+    sHotplugCond.broadcast();
+}
+
+static void vsyncProc(const struct hwc_procs * /* procs */, int /* disp */,
+                      int64_t /* timestamp */)
+{
+}
+
+static void invalidateProc(const struct hwc_procs * /* procs */)
+{
+}
+
+// the replay devices report themselves as SurfaceFlinger would see it
+static bool waitForDisplays()
+{
+    Mutex::Autolock _l(sHotplugLock);
+    nsecs_t deadline = systemTime(SYSTEM_TIME_MONOTONIC) + ms2ns(HOTPLUG_WAIT_MS);
+    while (sHotplugCount < REPLAY_DISPLAY_COUNT) {
+        nsecs_t remaining = deadline - systemTime(SYSTEM_TIME_MONOTONIC);
+        if (remaining <= 0) {
+            return false;
+        }
+        sHotplugCond.waitRelative(sHotplugLock, remaining);
+    }
+    return true;
+}
+
+static void setupLayer(hwc_layer_1_t& dst, const frame_trace_layer& src,
+                       bool geometryChanged)
+{
+    if (geometryChanged) {
+        // SurfaceFlinger hands a new geometry over for GLES composition,
+        // otherwise the types from the last prepare are kept
+        memset(&dst, 0, sizeof(dst));
+        if (src.composition_type == HWC_FRAMEBUFFER_TARGET ||
+            src.composition_type == HWC_SIDEBAND) {
+            dst.compositionType = src.composition_type;
+        } else {
+            dst.compositionType = HWC_FRAMEBUFFER;
+        }
+    }
+
+    dst.hints = 0;
+    dst.flags = src.flags;
+    dst.handle = (buffer_handle_t)src.handle;
+    dst.transform = src.transform;
+    dst.blending = src.blending;
+    dst.sourceCropf.left = src.source_crop[0];
+    dst.sourceCropf.top = src.source_crop[1];
+    dst.sourceCropf.right = src.source_crop[2];
+    dst.sourceCropf.bottom = src.source_crop[3];
+    dst.displayFrame.left = src.display_frame[0];
+    dst.displayFrame.top = src.display_frame[1];
+    dst.displayFrame.right = src.display_frame[2];
+    dst.displayFrame.bottom = src.display_frame[3];
+    dst.planeAlpha = src.plane_alpha;
+    dst.acquireFenceFd = -1;
+    dst.releaseFenceFd = -1;
+}
+
+// rebuilds the contents of a traced display, false if the display is
+// left out of the frame
+static bool setupDisplay(ReplayDisplay& display,
+                         const frame_trace_display& traced,
+                         const frame_trace_layer *layers,
+                         ReplayBufferManager *bm)
+{
+    if (!traced.num_hw_layers) {
+        return false;
+    }
+
+    // the frame buffer target is the last layer, a truncated list
+    // can't be prepared
+    if (traced.num_layers != traced.num_hw_layers) {
+        display.truncated++;
+        return false;
+    }
+
+    hwc_display_contents_1_t *contents = display.contents;
+    bool geometryChanged = (traced.flags & HWC_GEOMETRY_CHANGED) ||
+                           !display.active ||
+                           contents->numHwLayers != traced.num_layers;
+
+    contents->retireFenceFd = -1;
+    contents->flags = traced.flags;
+    if (geometryChanged) {
+        contents->flags |= HWC_GEOMETRY_CHANGED;
+    }
+    contents->numHwLayers = traced.num_layers;
+    for (uint32_t i = 0; i < traced.num_layers; i++) {
+        bm->addBuffer(layers[i]);
+        setupLayer(contents->hwLayers[i], layers[i], geometryChanged);
+    }
+    return true;
+}
+
+static void compareDisplay(ReplayDisplay& display,
+                           const frame_trace_layer *layers)
+{
+    hwc_display_contents_1_t *contents = display.contents;
+
+    display.frames++;
+    for (size_t i = 0; i + 1 < contents->numHwLayers; i++) {
+        uint32_t recorded = layers[i].composition_type;
+        int32_t replayed = contents->hwLayers[i].compositionType;
+
+        display.layers++;
+        if (recorded == HWC_OVERLAY || recorded == HWC_CURSOR_OVERLAY) {
+            display.recordedOverlays++;
+        }
+        if (replayed == HWC_OVERLAY || replayed == HWC_CURSOR_OVERLAY) {
+            display.replayedOverlays++;
+        }
+        if ((int32_t)recorded != replayed) {
+            display.mismatches++;
+        }
+    }
+}
+
+static bool replay(FILE *file, ReplayHwcomposer& hwc)
+{
+    frame_trace_header header;
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        header.magic != FRAME_TRACE_MAGIC) {
+        fprintf(stderr, "not a frame trace\n");
+        return false;
+    }
+    if (header.version != FRAME_TRACE_VERSION ||
+        header.layer_size != sizeof(frame_trace_layer)) {
+        fprintf(stderr, "unsupported trace version %u, layer size %u\n",
+                header.version, header.layer_size);
+        return false;
+    }
+
+    size_t contentsSize = sizeof(hwc_display_contents_1_t) +
+                          REPLAY_LAYER_COUNT * sizeof(hwc_layer_1_t);
+    ReplayDisplay displays[REPLAY_DISPLAY_COUNT];
+    memset(displays, 0, sizeof(displays));
+    for (int i = 0; i < REPLAY_DISPLAY_COUNT; i++) {
+        displays[i].contents = (hwc_display_contents_1_t *)calloc(1, contentsSize);
+        if (!displays[i].contents) {
+            fprintf(stderr, "failed to allocate display contents\n");
+            for (int j = 0; j < i; j++) {
+                free(displays[j].contents);
+            }
+            return false;
+        }
+    }
+
+    ReplayBufferManager *bm = hwc.getReplayBufferManager();
+    // recorded layers of the replayed displays, kept to compare with
+    frame_trace_layer layers[REPLAY_DISPLAY_COUNT][REPLAY_LAYER_COUNT];
+    frame_trace_layer skipped[REPLAY_LAYER_COUNT];
+    LatencyStat recordedPrepare, replayedPrepare;
+    LatencyStat recordedCommit, replayedCommit;
+    uint32_t frames = 0;
+    bool valid = true;
+
+    memset(&recordedPrepare, 0, sizeof(recordedPrepare));
+    memset(&replayedPrepare, 0, sizeof(replayedPrepare));
+    memset(&recordedCommit, 0, sizeof(recordedCommit));
+    memset(&replayedCommit, 0, sizeof(replayedCommit));
+
+    for (; valid && frames < header.frame_count; frames++) {
+        frame_trace_frame frame;
+        if (fread(&frame, sizeof(frame), 1, file) != 1) {
+            valid = false;
+            break;
+        }
+
+        hwc_display_contents_1_t *lists[REPLAY_DISPLAY_COUNT] = { NULL };
+        for (uint32_t i = 0; i < frame.num_displays; i++) {
+            frame_trace_layer *dst = (i < REPLAY_DISPLAY_COUNT) ? layers[i] : skipped;
+            frame_trace_display traced;
+            if (fread(&traced, sizeof(traced), 1, file) != 1 ||
+                traced.num_layers > REPLAY_LAYER_COUNT ||
+                fread(dst, sizeof(frame_trace_layer), traced.num_layers,
+                      file) != traced.num_layers) {
+                valid = false;
+                break;
+            }
+
+            if (i < REPLAY_DISPLAY_COUNT &&
+                setupDisplay(displays[i], traced, dst, bm)) {
+                lists[i] = displays[i].contents;
+            }
+        }
+        if (!valid) {
+            break;
+        }
+
+        for (int i = 0; i < REPLAY_DISPLAY_COUNT; i++) {
+            displays[i].active = (lists[i] != NULL);
+        }
+
+        nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+        hwc.prepare(REPLAY_DISPLAY_COUNT, lists);
+        addLatency(replayedPrepare, systemTime(SYSTEM_TIME_MONOTONIC) - start);
+        addLatency(recordedPrepare, frame.prepare_duration);
+
+        for (int i = 0; i < REPLAY_DISPLAY_COUNT; i++) {
+            if (lists[i]) {
+                compareDisplay(displays[i], layers[i]);
+            }
+        }
+
+        start = systemTime(SYSTEM_TIME_MONOTONIC);
+        hwc.commit(REPLAY_DISPLAY_COUNT, lists);
+        addLatency(replayedCommit, systemTime(SYSTEM_TIME_MONOTONIC) - start);
+        if (frame.commit_duration) {
+            addLatency(recordedCommit, frame.commit_duration);
+        }
+    }
+
+    printf("%u of %u frames replayed\n", frames, header.frame_count);
+    printLatency("prepare", recordedPrepare, replayedPrepare);
+    printLatency("commit", recordedCommit, replayedCommit);
+    for (int i = 0; i < REPLAY_DISPLAY_COUNT; i++) {
+        const ReplayDisplay& display = displays[i];
+        if (display.frames || display.truncated) {
+            printf("display %d: %u frames, %u truncated, %u layers, "
+                   "overlay recorded %u replayed %u, %u mismatches\n",
+                   i,
+                   display.frames,
+                   display.truncated,
+                   display.layers,
+                   display.recordedOverlays,
+                   display.replayedOverlays,
+                   display.mismatches);
+        }
+    }
+
+    // let the devices drop their layer lists
+    hwc_display_contents_1_t *none[REPLAY_DISPLAY_COUNT] = { NULL };
+    hwc.prepare(REPLAY_DISPLAY_COUNT, none);
+    for (int i = 0; i < REPLAY_DISPLAY_COUNT; i++) {
+        free(displays[i].contents);
+    }
+
+    if (!valid) {
+        fprintf(stderr, "trace is truncated after frame %u\n", frames);
+    }
+    return valid;
+}
+
+static int getPlaneCount(const char *arg)
+{
+    int planes = atoi(arg);
+    if (planes < 0 || planes > MAX_REPLAY_PLANES) {
+        return -1;
+    }
+    return planes;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-s sprites] [-o overlays] [-d] <trace file>\n", name);
+    fprintf(stderr, "  -s  sprite planes per display, default 3\n");
+    fprintf(stderr, "  -o  overlay planes per display, default 2\n");
+    fprintf(stderr, "  -d  print the hwc dump after the replay\n");
+}
+
+int main(int argc, char **argv)
+{
+    int spritePlanes = 3;
+    int overlayPlanes = 2;
+    bool dump = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:o:d")) != -1) {
+        switch (opt) {
+        case 's':
+            spritePlanes = getPlaneCount(optarg);
+            break;
+        case 'o':
+            overlayPlanes = getPlaneCount(optarg);
+            break;
+        case 'd':
+            dump = true;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (optind >= argc || spritePlanes < 0 || overlayPlanes < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    FILE *file = fopen(argv[optind], "rb");
+    if (!file) {
+        fprintf(stderr, "failed to open %s\n", argv[optind]);
+        return 1;
+    }
+
+    ReplayHwcomposer& hwc = static_cast<ReplayHwcomposer&>(Hwcomposer::getInstance());
+    hwc.setPlaneBudget(spritePlanes, overlayPlanes);
+    if (!hwc.initialize()) {
+        fprintf(stderr, "failed to initialize hwc\n");
+        fclose(file);
+        Hwcomposer::releaseInstance();
+        return 1;
+    }
+
+    hwc_procs_t procs;
+    procs.invalidate = invalidateProc;
+    procs.vsync = vsyncProc;
+    procs.hotplug = hotplugProc;
+    hwc.registerProcs(&procs);
+    if (!waitForDisplays()) {
+        fprintf(stderr, "replay displays were not reported\n");
+    }
+
+    printf("replaying %s on %d sprites, %d overlays per display\n",
+           argv[optind], spritePlanes, overlayPlanes);
+    bool ret = replay(file, hwc);
+    fclose(file);
+
+    if (dump) {
+        char *buff = (char *)calloc(1, DUMP_BUFFER_SIZE);
+        int len = 0;
+        if (buff && hwc.dump(buff, DUMP_BUFFER_SIZE, &len)) {
+            printf("%s\n", buff);
+        }
+        free(buff);
+    }
+
+    hwc.registerProcs(NULL);
+    Hwcomposer::releaseInstance();
+    return ret ? 0 : 1;
+}
@@ -0,0 +1,314 @@
+/*
+// Copyright (c) 2014 Intel Corporation 
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <map>
+#include <common/utils/FrameTraceFormat.h>
+
+// Host side reader for the frame traces saved by FrameTracer. It walks
+// the recorded frames in order and reports composition behavior and
+// prepare/set latency of the captured workload. Plane allocation of a
+// trace is replayed through the hwc by hwcreplay instead.
+
+// mirrors hardware/hwcomposer_defs.h, host builds don't see it
+enum {
+    TRACE_HWC_FRAMEBUFFER = 0,
+    TRACE_HWC_OVERLAY = 1,
+    TRACE_HWC_BACKGROUND = 2,
+    TRACE_HWC_FRAMEBUFFER_TARGET = 3,
+    TRACE_HWC_SIDEBAND = 4,
+    TRACE_HWC_CURSOR_OVERLAY = 5,
+    TRACE_HWC_TYPE_COUNT,
+};
+
+enum {
+    TRACE_HWC_GEOMETRY_CHANGED = 0x00000001,
+};
+
+enum {
+    MAX_DISPLAYS = 3,
+};
+
+static const char* sTypeNames[TRACE_HWC_TYPE_COUNT] = {
+    "FB",
+    "OVERLAY",
+    "BACKGROUND",
+    "FB_TARGET",
+    "SIDEBAND",
+    "CURSOR",
+};
+
+struct LatencyStat {
+    int64_t count;
+    int64_t total;
+    int64_t max;
+};
+
+struct DisplayStat {
+    int64_t frames;
+    int64_t geometryChanges;
+    int64_t layers;
+    int64_t truncated;
+    int64_t bufferChanges;
+    int64_t types[TRACE_HWC_TYPE_COUNT];
+    int64_t fbOnlyFrames;
+};
+
+static void addLatency(LatencyStat& stat, int64_t ns)
+{
+    stat.count++;
+    stat.total += ns;
+    if (ns > stat.max) {
+        stat.max = ns;
+    }
+}
+
+static void printLatency(const char *name, const LatencyStat& stat)
+{
+    if (!stat.count) {
+        printf("  %-8s: no samples\n", name);
+        return;
+    }
+    printf("  %-8s: %lld samples, avg %lld us, max %lld us\n",
+           name,
+           (long long)stat.count,
+           (long long)(stat.total / stat.count / 1000),
+           (long long)(stat.max / 1000));
+}
+
+static const char* typeName(uint32_t type)
+{
+    if (type < TRACE_HWC_TYPE_COUNT) {
+        return sTypeNames[type];
+    }
+    return "UNKNOWN";
+}
+
+static void printLayer(size_t index, const frame_trace_layer& layer)
+{
+    printf("      %2u %-10s stamp %#llx fmt %#x %dx%d "
+           "crop %.1f,%.1f-%.1f,%.1f dst %d,%d-%d,%d tr %#x bl %#x a %u\n",
+           (unsigned)index,
+           typeName(layer.composition_type),
+           (unsigned long long)layer.buffer,
+           layer.format,
+           layer.width, layer.height,
+           layer.source_crop[0], layer.source_crop[1],
+           layer.source_crop[2], layer.source_crop[3],
+           layer.display_frame[0], layer.display_frame[1],
+           layer.display_frame[2], layer.display_frame[3],
+           layer.transform,
+           layer.blending,
+           layer.plane_alpha);
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-v] <trace file>\n", name);
+    fprintf(stderr, "  -v  print every recorded frame and layer\n");
+}
+
+int main(int argc, char **argv)
+{
+    bool verbose = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "v")) != -1) {
+        switch (opt) {
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (optind >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    FILE *file = fopen(argv[optind], "rb");
+    if (!file) {
+        fprintf(stderr, "failed to open %s\n", argv[optind]);
+        return 1;
+    }
+
+    frame_trace_header header;
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        header.magic != FRAME_TRACE_MAGIC) {
+        fprintf(stderr, "not a frame trace\n");
+        fclose(file);
+        return 1;
+    }
+    if (header.version != FRAME_TRACE_VERSION ||
+        header.layer_size != sizeof(frame_trace_layer)) {
+        fprintf(stderr, "unsupported trace version %u, layer size %u\n",
+                header.version, header.layer_size);
+        fclose(file);
+        return 1;
+    }
+
+    LatencyStat prepare;
+    LatencyStat commit;
+    LatencyStat interval;
+    DisplayStat displays[MAX_DISPLAYS];
+    // last buffer seen per display and layer index
+    std::map<uint32_t, uint64_t> lastBuffers[MAX_DISPLAYS];
+    std::map<uint64_t, int> uniqueBuffers;
+    int64_t firstTimestamp = 0;
+    int64_t lastTimestamp = 0;
+    uint32_t frames = 0;
+
+    memset(&prepare, 0, sizeof(prepare));
+    memset(&commit, 0, sizeof(commit));
+    memset(&interval, 0, sizeof(interval));
+    memset(displays, 0, sizeof(displays));
+
+    for (; frames < header.frame_count; frames++) {
+        frame_trace_frame frame;
+        if (fread(&frame, sizeof(frame), 1, file) != 1) {
+            fprintf(stderr, "truncated trace at frame %u\n", frames);
+            break;
+        }
+
+        if (frames == 0) {
+            firstTimestamp = frame.timestamp;
+        } else {
+            addLatency(interval, frame.timestamp - lastTimestamp);
+        }
+        lastTimestamp = frame.timestamp;
+
+        addLatency(prepare, frame.prepare_duration);
+        if (frame.commit_duration) {
+            addLatency(commit, frame.commit_duration);
+        }
+
+        if (verbose) {
+            printf("frame %u at +%lld us, prepare %lld us, set %lld us\n",
+                   frames,
+                   (long long)((frame.timestamp - firstTimestamp) / 1000),
+                   (long long)(frame.prepare_duration / 1000),
+                   (long long)(frame.commit_duration / 1000));
+        }
+
+        bool valid = true;
+        for (uint32_t i = 0; valid && i < frame.num_displays; i++) {
+            frame_trace_display display;
+            if (fread(&display, sizeof(display), 1, file) != 1) {
+                valid = false;
+                break;
+            }
+            if (!display.num_hw_layers || i >= MAX_DISPLAYS) {
+                // still need to skip the layers
+                for (uint32_t j = 0; j < display.num_layers; j++) {
+                    frame_trace_layer layer;
+                    if (fread(&layer, sizeof(layer), 1, file) != 1) {
+                        valid = false;
+                        break;
+                    }
+                }
+                continue;
+            }
+
+            DisplayStat& stat = displays[i];
+            stat.frames++;
+            stat.layers += display.num_hw_layers;
+            stat.truncated += display.num_hw_layers - display.num_layers;
+            if (display.flags & TRACE_HWC_GEOMETRY_CHANGED) {
+                stat.geometryChanges++;
+            }
+
+            if (verbose) {
+                printf("    disp %u: %u layers%s\n", i, display.num_hw_layers,
+                       (display.flags & TRACE_HWC_GEOMETRY_CHANGED) ?
+                       ", geometry changed" : "");
+            }
+
+            bool fbOnly = true;
+            for (uint32_t j = 0; j < display.num_layers; j++) {
+                frame_trace_layer layer;
+                if (fread(&layer, sizeof(layer), 1, file) != 1) {
+                    valid = false;
+                    break;
+                }
+                if (layer.composition_type < TRACE_HWC_TYPE_COUNT) {
+                    stat.types[layer.composition_type]++;
+                }
+                if (layer.composition_type == TRACE_HWC_OVERLAY ||
+                    layer.composition_type == TRACE_HWC_CURSOR_OVERLAY) {
+                    fbOnly = false;
+                }
+                if (layer.buffer) {
+                    uniqueBuffers[layer.buffer]++;
+                    std::map<uint32_t, uint64_t>::iterator it = lastBuffers[i].find(j);
+                    if (it != lastBuffers[i].end() && it->second != layer.buffer) {
+                        stat.bufferChanges++;
+                    }
+                    lastBuffers[i][j] = layer.buffer;
+                }
+                if (verbose) {
+                    printLayer(j, layer);
+                }
+            }
+            if (fbOnly) {
+                stat.fbOnlyFrames++;
+            }
+        }
+
+        if (!valid) {
+            fprintf(stderr, "truncated trace at frame %u\n", frames);
+            break;
+        }
+    }
+    fclose(file);
+
+    printf("%u frames over %lld ms, %u unique buffers\n",
+           frames,
+           (long long)((lastTimestamp - firstTimestamp) / 1000000),
+           (unsigned)uniqueBuffers.size());
+    printLatency("prepare", prepare);
+    printLatency("set", commit);
+    printLatency("interval", interval);
+
+    for (int i = 0; i < MAX_DISPLAYS; i++) {
+        const DisplayStat& stat = displays[i];
+        if (!stat.frames) {
+            continue;
+        }
+        printf("display %d: %lld frames, %lld geometry changes, "
+               "%.1f layers/frame, %lld GPU only frames, %lld buffer changes\n",
+               i,
+               (long long)stat.frames,
+               (long long)stat.geometryChanges,
+               (double)stat.layers / stat.frames,
+               (long long)stat.fbOnlyFrames,
+               (long long)stat.bufferChanges);
+        for (int j = 0; j < TRACE_HWC_TYPE_COUNT; j++) {
+            if (stat.types[j]) {
+                printf("    %-10s %lld\n", sTypeNames[j], (long long)stat.types[j]);
+            }
+        }
+        if (stat.truncated) {
+            printf("    %lld layers not recorded\n", (long long)stat.truncated);
+        }
+    }
+
+    return 0;
+}